@@ -0,0 +1,134 @@
+#include "BranchPredictor.h"
+#include <cstdio>
+#include <iomanip>
+#include <stdexcept>
+
+// 2-bit saturating counter helpers (0,1 predict not taken; 2,3 predict taken)
+static void train(uint8_t& counter, bool taken) {
+    if (taken && counter < 3) ++counter;
+    else if (!taken && counter > 0) --counter;
+}
+
+static uint32_t tableMask(uint32_t bits) {
+    if (bits == 0 || bits > 24) throw std::runtime_error("Predictor table bits must be between 1 and 24");
+    return (1u << bits) - 1;
+}
+
+bool StaticPredictor::predict(uint32_t, bool backward) {
+    switch (mode_) {
+        case Mode::TAKEN: return true;
+        case Mode::NOT_TAKEN: return false;
+        default: return backward;
+    }
+}
+
+BimodalPredictor::BimodalPredictor(const std::string& name, uint32_t indexBits)
+    : BranchPredictor(name), mask_(tableMask(indexBits)) {
+    counters_.assign(mask_ + 1, 1); // weakly not taken
+}
+
+bool BimodalPredictor::predict(uint32_t pc, bool) { return counters_[pc & mask_] >= 2; }
+
+void BimodalPredictor::update(uint32_t pc, bool taken) { train(counters_[pc & mask_], taken); }
+
+GsharePredictor::GsharePredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits)
+    : BranchPredictor(name), mask_(tableMask(indexBits)),
+      historyMask_(historyBits >= 32 ? ~0u : (1u << historyBits) - 1) {
+    counters_.assign(mask_ + 1, 1);
+}
+
+bool GsharePredictor::predict(uint32_t pc, bool) { return counters_[(pc ^ history_) & mask_] >= 2; }
+
+void GsharePredictor::update(uint32_t pc, bool taken) {
+    train(counters_[(pc ^ history_) & mask_], taken);
+    history_ = ((history_ << 1) | (taken ? 1 : 0)) & historyMask_;
+}
+
+TournamentPredictor::TournamentPredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits)
+    : BranchPredictor(name), bimodal_("bimodal", indexBits), gshare_("gshare", indexBits, historyBits),
+      mask_(tableMask(indexBits)) {
+    chooser_.assign(mask_ + 1, 1); // weakly prefer bimodal
+}
+
+bool TournamentPredictor::predict(uint32_t pc, bool backward) {
+    bimodalGuess_ = bimodal_.predict(pc, backward);
+    gshareGuess_ = gshare_.predict(pc, backward);
+    return chooser_[pc & mask_] >= 2 ? gshareGuess_ : bimodalGuess_;
+}
+
+void TournamentPredictor::update(uint32_t pc, bool taken) {
+    // Move the chooser towards whichever component was right when they disagree
+    if (bimodalGuess_ != gshareGuess_) train(chooser_[pc & mask_], gshareGuess_ == taken);
+    bimodal_.update(pc, taken);
+    gshare_.update(pc, taken);
+}
+
+std::unique_ptr<BranchPredictor> makeBranchPredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits) {
+    if (name == "static") return std::make_unique<StaticPredictor>(name, StaticPredictor::Mode::BTFN);
+    if (name == "taken") return std::make_unique<StaticPredictor>(name, StaticPredictor::Mode::TAKEN);
+    if (name == "not-taken") return std::make_unique<StaticPredictor>(name, StaticPredictor::Mode::NOT_TAKEN);
+    if (name == "bimodal") return std::make_unique<BimodalPredictor>(name, indexBits);
+    if (name == "gshare") return std::make_unique<GsharePredictor>(name, indexBits, historyBits);
+    if (name == "tournament") return std::make_unique<TournamentPredictor>(name, indexBits, historyBits);
+    throw std::runtime_error("Unknown branch predictor: " + name);
+}
+
+void BranchPredictorSet::add(std::unique_ptr<BranchPredictor> predictor) {
+    predictors_.push_back(std::move(predictor));
+    mispredictions_.push_back(0);
+}
+
+bool BranchPredictorSet::record(uint32_t pc, bool backward, bool taken) {
+    if (pc >= branches_.size()) branches_.resize(pc + 1);
+    BranchStats& stats = branches_[pc];
+    if (stats.mispredictions.empty()) stats.mispredictions.assign(predictors_.size(), 0);
+    ++stats.executed;
+    if (taken) ++stats.taken;
+    ++executed_;
+
+    bool firstMispredicted = false;
+    for (size_t i = 0; i < predictors_.size(); ++i) {
+        bool mispredicted = predictors_[i]->predict(pc, backward) != taken;
+        predictors_[i]->update(pc, taken);
+        if (mispredicted) {
+            ++stats.mispredictions[i];
+            ++mispredictions_[i];
+            if (i == 0) firstMispredicted = true;
+        }
+    }
+    return firstMispredicted;
+}
+
+static double percent(uint64_t part, uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; }
+
+void BranchPredictorSet::report(std::ostream& out, const Memory& memory) const {
+    out << "\n==== Branch prediction ====\n";
+    out << "Branches executed: " << executed_ << "\n";
+    std::ios_base::fmtflags flags = out.flags(); // the caller's formatting is restored at the end
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < predictors_.size(); ++i) {
+        out << std::left << std::setw(12) << predictors_[i]->getName() << mispredictions_[i]
+            << " mispredictions (" << percent(mispredictions_[i], executed_) << "%)\n";
+    }
+
+    out << "Misprediction rate per branch:\n";
+    out << "  PC    executed    taken%   ";
+    for (const auto& predictor : predictors_) out << std::setw(12) << predictor->getName();
+    out << "source\n";
+    for (uint32_t pc = 0; pc < branches_.size(); ++pc) {
+        const BranchStats& stats = branches_[pc];
+        if (!stats.executed) continue;
+        out << "  " << std::setw(6) << pc << std::setw(12) << stats.executed
+            << std::setw(9) << percent(stats.taken, stats.executed);
+        for (uint64_t m : stats.mispredictions) {
+            char rate[16];
+            std::snprintf(rate, sizeof(rate), "%.2f%%", percent(m, stats.executed));
+            out << std::setw(12) << rate;
+        }
+        if (pc < memory.instructionCount()) out << memory.getSourceLine(pc);
+        out << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Memory.h"
+
+// Interface of a conditional branch direction predictor
+class BranchPredictor {
+public:
+    explicit BranchPredictor(const std::string& name) : name_(name) {}
+    virtual ~BranchPredictor() = default;
+
+    const std::string& getName() const { return name_; }
+
+    // Predict the direction of the branch at pc (backward: negative offset)
+    virtual bool predict(uint32_t pc, bool backward) = 0;
+    // Train with the actual outcome
+    virtual void update(uint32_t pc, bool taken) = 0;
+
+private:
+    std::string name_;
+};
+
+// Always taken, always not taken, or backward-taken/forward-not-taken
+class StaticPredictor : public BranchPredictor {
+public:
+    enum class Mode { NOT_TAKEN, TAKEN, BTFN };
+    StaticPredictor(const std::string& name, Mode mode) : BranchPredictor(name), mode_(mode) {}
+    bool predict(uint32_t pc, bool backward) override;
+    void update(uint32_t, bool) override {}
+private:
+    Mode mode_;
+};
+
+// Table of 2-bit saturating counters indexed by PC
+class BimodalPredictor : public BranchPredictor {
+public:
+    BimodalPredictor(const std::string& name, uint32_t indexBits);
+    bool predict(uint32_t pc, bool backward) override;
+    void update(uint32_t pc, bool taken) override;
+private:
+    std::vector<uint8_t> counters_;
+    uint32_t mask_;
+};
+
+// 2-bit counters indexed by PC xor global branch history
+class GsharePredictor : public BranchPredictor {
+public:
+    GsharePredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits);
+    bool predict(uint32_t pc, bool backward) override;
+    void update(uint32_t pc, bool taken) override;
+private:
+    std::vector<uint8_t> counters_;
+    uint32_t mask_;
+    uint32_t historyMask_;
+    uint32_t history_ = 0;
+};
+
+// Chooses per PC between a bimodal and a gshare component
+class TournamentPredictor : public BranchPredictor {
+public:
+    TournamentPredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits);
+    bool predict(uint32_t pc, bool backward) override;
+    void update(uint32_t pc, bool taken) override;
+private:
+    BimodalPredictor bimodal_;
+    GsharePredictor gshare_;
+    std::vector<uint8_t> chooser_; // >= 2 selects gshare
+    uint32_t mask_;
+    bool bimodalGuess_ = false;
+    bool gshareGuess_ = false;
+};
+
+// Build a predictor by name: static (BTFN), taken, not-taken, bimodal, gshare or tournament
+std::unique_ptr<BranchPredictor> makeBranchPredictor(const std::string& name, uint32_t indexBits, uint32_t historyBits);
+
+// Runs several predictors side by side on the same branch stream so they can be
+// compared in a single execution. The first predictor is the one whose
+// mispredictions are charged to the pipeline timing model.
+class BranchPredictorSet {
+public:
+    void add(std::unique_ptr<BranchPredictor> predictor);
+    bool empty() const { return predictors_.empty(); }
+
+    // Record the outcome of the branch at pc and train every predictor.
+    // Returns whether the first predictor mispredicted it.
+    bool record(uint32_t pc, bool backward, bool taken);
+
+    // Print overall and per-branch misprediction rates of every predictor
+    void report(std::ostream& out, const Memory& memory) const;
+
+private:
+    struct BranchStats {
+        uint64_t executed = 0;
+        uint64_t taken = 0;
+        std::vector<uint64_t> mispredictions; // one counter per predictor
+    };
+
+    std::vector<std::unique_ptr<BranchPredictor>> predictors_;
+    std::vector<uint64_t> mispredictions_; // totals, one per predictor
+    std::vector<BranchStats> branches_;    // indexed by PC
+    uint64_t executed_ = 0;
+};
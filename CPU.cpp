@@ -1,68 +1,195 @@
 #include "CPU.h"
+#include "ElfLoader.h"
+#include "Incremental.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <fstream>
 #include <stdexcept>
 #include <string>
 
-CPU::CPU(std::string& instructionFile, std::string& dataFile) : registers_{}, pc_{0} {
-        memory_ = new Memory(instructionFile, dataFile);
+CPU::CPU(std::string& instructionFile, std::string& dataFile)
+    : registers_{}, pc_{0}, memory_(std::make_unique<Memory>(instructionFile, dataFile)) {}
+
+CPU::CPU() : registers_{}, pc_{0}, memory_(std::make_unique<Memory>()) {}
+
+void CPU::loadElf(const std::string& filename) {
+    uint32_t entry = loadElfExecutable(filename, *memory_, elfStackPointer_);
+    elfEntry_ = memory_->codeIndex(entry);
+    reset();
+}
+
+void CPU::reset() {
+    bool binary = memory_->isBinaryProgram();
+    registers_ = {};
+    if (binary) registers_[2] = elfStackPointer_; // sp
+    pc_ = binary ? elfEntry_ : 0;
+    retiredBase_ = 0;
+    blockStart_ = pc_;
+    exitCode_ = 0;
+    stopped_ = false;
+    memoryStall_ = 0;
+    mispredicted_ = false;
+    budgetExhausted_ = false;
+    enforceX0_ = !binary; // compiled code uses x0 as a discard register
+}
+
+void CPU::restoreState(const State& state) {
+    registers_ = state.registers;
+    pc_ = state.pc;
+    retiredBase_ = state.retiredBase;
+    blockStart_ = state.blockStart;
+    exitCode_ = state.exitCode;
+    stopped_ = state.halted;
+    if (stopped_) pc_ = blockStart_ = memory_->instructionCount(); // past the end of the program loaded now
+    memoryStall_ = 0;
+    mispredicted_ = false;
+    budgetExhausted_ = false;
+}
+
+void CPU::run() {
+    startTime_ = std::chrono::steady_clock::now();
+    budgetExhausted_ = false;
+    try {
+        switch (engine_) {
+            case Engine::CHECKED: runEngine<CheckedPolicy>(); break;
+            case Engine::TRACE:   runEngine<TracePolicy>();   break;
+            case Engine::FAST:    runEngine<FastPolicy>();    break;
+        }
+    } catch (...) {
+        console_.flush(); // show what the program printed before it failed
+        throw;
     }
+    console_.flush();
+}
 
-CPU::CPU() : registers_{}, pc_{0} {
-    memory_ = new Memory();
+bool CPU::step() {
+    switch (engine_) {
+        case Engine::TRACE: return stepEngine<TracePolicy>();
+        case Engine::FAST:  return stepEngine<FastPolicy>();
+        default:            return stepEngine<CheckedPolicy>();
+    }
 }
 
-void CPU::run() {
-    while (step());
+uint64_t CPU::runSlice(uint64_t maxInstructions) {
+    switch (engine_) {
+        case Engine::TRACE: return runSliceEngine<TracePolicy>(maxInstructions);
+        case Engine::FAST:  return runSliceEngine<FastPolicy>(maxInstructions);
+        default:            return runSliceEngine<CheckedPolicy>(maxInstructions);
+    }
+}
+
+template <class Policy>
+uint64_t CPU::runSliceEngine(uint64_t maxInstructions) {
+    uint64_t executed = 0;
+    while (executed < maxInstructions && stepEngine<Policy>()) ++executed;
+    return executed;
+}
+
+template <class Policy>
+void CPU::runEngine() {
+    if (budget_ == 0) {
+        while (stepEngine<Policy>());
+        return;
+    }
+    // A program whose last instruction used up the budget has still finished
+    budgetExhausted_ = runSliceEngine<Policy>(budget_) == budget_ && !halted();
+}
+
+bool CPU::halted() const {
+    if (stopped_ || pc_ >= memory_->instructionCount()) return true;
+    return isNop(memory_->fetchDecoded(pc_)) && !memory_->isBinaryProgram();
 }
 
 // fetch, decode, execute cycle
-bool CPU::step() {
-    int32_t prevPC = pc_; // Save previous PC for debugging
+template <class Policy>
+bool CPU::stepEngine() {
+    uint32_t prevPC = pc_; // Save previous PC for debugging
     if (pc_ >= memory_->instructionCount())
         return false;
 
-    const Instruction& inst = memory_->fetchInstruction(pc_);       // fetch and decode
-    if(inst.getOpcode() == Opcode::NOP) return false;
-    // std::cout << "\nExecuting instruction at PC " << pc_ << ": " << inst.toString() << std::endl;
-    execute(inst);                                                  // execute the instruction
+    const DecodedInstruction& inst = memory_->fetchDecoded(pc_);    // fetch (decoded at load time)
+    if(isNop(inst) && !memory_->isBinaryProgram()) return false;
+    if constexpr (Policy::trace)
+        *diagnostics_ << "\nExecuting instruction at PC " << pc_ << ": " << memory_->getSourceLine(pc_) << std::endl;
+    execute<Policy>(inst);                                          // execute the instruction
     registers_[0] = 0; // x0 is always zero, reset it after each instruction since JAL might modify it
+    if constexpr (Policy::profile) {
+        if (stats_) stats_->countExecution(prevPC);
+        if (timing_) {
+            timing_->retire(prevPC, inst, mispredicted_, memoryStall_);
+            memoryStall_ = 0;
+            mispredicted_ = false;
+        }
+    }
     // print the state of registers for debugging
-    // printRegisters();
+    if constexpr (Policy::trace) printRegisters(*diagnostics_);
     if(pc_ == prevPC) ++pc_; // May be changed by jump/branch
+    else {
+        retiredBase_ += prevPC + 1 - blockStart_; // close the straight-line block
+        blockStart_ = pc_;
+        if constexpr (Policy::profile) {
+            if (session_) session_->blockBoundary(prevPC);
+        }
+    }
     return true;
 }
 
-void CPU::execute(const Instruction& inst) {
-    switch (inst.getOpcode()) {
-        case Opcode::ADD : executeADD(inst.getOperands());  break;
-        case Opcode::ADDI: executeADDI(inst.getOperands()); break;
-        case Opcode::SUB : executeSUB(inst.getOperands());  break;
-        case Opcode::LI  : executeLI(inst.getOperands());   break;
-        case Opcode::SW  : executeSW(inst.getOperands());   break;
-        case Opcode::LA  : executeLA(inst.getOperands());   break;
-        case Opcode::BEQ : executeBEQ(inst.getOperands());  break;
-        case Opcode::BNE : executeBNE(inst.getOperands());  break;
-        case Opcode::BGE : executeBGE(inst.getOperands());  break;
-        case Opcode::BLT : executeBLT(inst.getOperands());  break;
-        case Opcode::LW  : executeLW(inst.getOperands());   break;
-        case Opcode::MUL : executeMUL(inst.getOperands());   break; 
-
-        case Opcode::LUI   : executeLUI(inst.getOperands());       break;
-        case Opcode::AUIPC : executeAUIPC(inst.getOperands(), pc_);break;
-        case Opcode::AND   : executeAND(inst.getOperands());       break;
-        case Opcode::OR    : executeOR(inst.getOperands());        break;
-        case Opcode::XOR   : executeXOR(inst.getOperands());       break;
-        case Opcode::ANDI  : executeANDI(inst.getOperands());      break;
-        case Opcode::SLL   : executeSLL(inst.getOperands());       break;
-        case Opcode::SRL   : executeSRL(inst.getOperands());       break;
-        case Opcode::SRA   : executeSRA(inst.getOperands());       break;
-        case Opcode::SLLI  : executeSLLI(inst.getOperands());      break; 
-        case Opcode::SRLI  : executeSRL(inst.getOperands());       break;
-        case Opcode::SRAI  : executeSRA(inst.getOperands());       break;
-        case Opcode::JALR  : executeJALR(inst.getOperands(), pc_); break;
-        case Opcode::JAL   : executeJAL(inst.getOperands(), pc_);  break;
-                    
+template <class Policy>
+void CPU::execute(const DecodedInstruction& inst) {
+    switch (inst.opcode) {
+        case Opcode::ADD : executeADD<Policy>(inst);  break;
+        case Opcode::ADDI: executeADDI<Policy>(inst); break;
+        case Opcode::SUB : executeSUB<Policy>(inst);  break;
+        case Opcode::SW  : executeSW<Policy>(inst);   break;
+        case Opcode::LA  : executeLA<Policy>(inst);   break;
+        case Opcode::BEQ : executeBEQ<Policy>(inst);  break;
+        case Opcode::BNE : executeBNE<Policy>(inst);  break;
+        case Opcode::BGE : executeBGE<Policy>(inst);  break;
+        case Opcode::BLT : executeBLT<Policy>(inst);  break;
+        case Opcode::LW  : executeLW<Policy>(inst);   break;
+        case Opcode::MUL : executeMUL<Policy>(inst);  break;
+
+        case Opcode::LUI   : executeLUI<Policy>(inst);        break;
+        case Opcode::AUIPC : executeAUIPC<Policy>(inst, pc_); break;
+        case Opcode::AND   : executeAND<Policy>(inst);        break;
+        case Opcode::OR    : executeOR<Policy>(inst);         break;
+        case Opcode::XOR   : executeXOR<Policy>(inst);        break;
+        case Opcode::ANDI  : executeANDI<Policy>(inst);       break;
+        case Opcode::SLL   : executeSLL<Policy>(inst);        break;
+        case Opcode::SRL   : executeSRL<Policy>(inst);        break;
+        case Opcode::SRA   : executeSRA<Policy>(inst);        break;
+        case Opcode::SLLI  : executeSLLI<Policy>(inst);       break;
+        case Opcode::SRLI  : executeSRLI<Policy>(inst);       break;
+        case Opcode::SRAI  : executeSRAI<Policy>(inst);       break;
+        case Opcode::JALR  : executeJALR<Policy>(inst, pc_);  break;
+        case Opcode::JAL   : executeJAL<Policy>(inst, pc_);   break;
+
+        case Opcode::SLT   : executeSLT<Policy>(inst);   break;
+        case Opcode::SLTU  : executeSLTU<Policy>(inst);  break;
+        case Opcode::SLTI  : executeSLTI<Policy>(inst);  break;
+        case Opcode::SLTIU : executeSLTIU<Policy>(inst); break;
+        case Opcode::XORI  : executeXORI<Policy>(inst);  break;
+        case Opcode::ORI   : executeORI<Policy>(inst);   break;
+        case Opcode::BLTU  : executeBLTU<Policy>(inst);  break;
+        case Opcode::BGEU  : executeBGEU<Policy>(inst);  break;
+        case Opcode::LB    : executeLB<Policy>(inst);    break;
+        case Opcode::LH    : executeLH<Policy>(inst);    break;
+        case Opcode::LBU   : executeLBU<Policy>(inst);   break;
+        case Opcode::LHU   : executeLHU<Policy>(inst);   break;
+        case Opcode::SB    : executeSB<Policy>(inst);    break;
+        case Opcode::SH    : executeSH<Policy>(inst);    break;
+        case Opcode::FENCE : break; // single hart, memory is always coherent
+        case Opcode::ECALL : executeECALL();     break;
+        case Opcode::EBREAK: halt();             break;
+
+        case Opcode::RDCYCLE   :
+        case Opcode::RDCYCLEH  :
+        case Opcode::RDTIME    :
+        case Opcode::RDTIMEH   :
+        case Opcode::RDINSTRET :
+        case Opcode::RDINSTRETH: executeCounterRead<Policy>(inst); break;
+
         default: throw std::runtime_error("Unknown opcode");
     }
 }
@@ -77,320 +204,423 @@ void CPU::setRegister(size_t idx, int32_t value) {
     if (idx >= registers_.size()) throw std::out_of_range("Register idx out of range");
     registers_[idx] = value;
 }
-int32_t CPU::registerindex(std::string reg) {                 // working as intended
-    if (reg[0] == 'x' && reg.length() > 1) {
-        return stoi(reg.substr(1));
-    }
-    return -1; // Invalid register
-}
 
 // Getter for program counter (PC)
 uint32_t CPU::getPC() const { return pc_; }
 
 // Print the state of all registers
-void CPU::printRegisters() const {
+void CPU::printRegisters(std::ostream& out) const {
     for(int32_t i=0; i<32; ++i) {
-        std::cout << "x" << std::left << std::setw(2) << i << ": " << std::left << std::setw(4) << registers_[i] << "  ";   
-        if(i % 8 == 7) std::cout << std::endl;
+        out << "x" << std::left << std::setw(2) << i << ": " << std::left << std::setw(4) << registers_[i] << "  ";
+        if(i % 8 == 7) out << std::endl;
     }
-    std::cout << std::endl;
+    out << std::endl;
 }
 
-// Logics for executing various instructions
-void CPU::executeADD(const Operands& ops) {
-    int32_t rdIdx = registerindex(ops.rd);
-    int32_t rs1Idx = registerindex(ops.rs1);
-    int32_t rs2Idx = registerindex(ops.rs2);
-    if (rdIdx == -1 || rs1Idx == -1 || rs2Idx == -1) {
-        throw std::runtime_error("Invalid operands for ADD");
-    }
-    if (rdIdx == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
+// Most ALU instructions refuse to write x0
+template <class Policy>
+void CPU::checkDestination(uint8_t rd) const {
+    if constexpr (Policy::enforceX0) {
+        if (rd == 0 && enforceX0_) {
+            throw std::runtime_error("Invalid Input! Can't modify register x0");
+        }
     }
-    setRegister(rdIdx, getRegister(rs1Idx) + getRegister(rs2Idx));
 }
 
-void CPU::executeSUB(const Operands& ops) {
-    int32_t rdIdx = registerindex(ops.rd);
-    int32_t rs1Idx = registerindex(ops.rs1);
-    int32_t rs2Idx = registerindex(ops.rs2);
-    if (rdIdx == -1 || rs1Idx == -1 || rs2Idx == -1) {
-        throw std::runtime_error("Invalid operands for SUB");
-    }
-    if (rdIdx == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rdIdx, getRegister(rs1Idx) - getRegister(rs2Idx));
+// Register access from the executors. Decoded register fields are 5 bits, so
+// the fast engine skips the range checks; its writes to x0 are undone by step().
+template <class Policy>
+int32_t CPU::readRegister(size_t idx) const {
+    if constexpr (Policy::checkBounds) return getRegister(idx);
+    else return registers_[idx];
 }
 
-void CPU::executeADDI(const Operands& ops) {
-    if(!ops.valid) throw std::runtime_error("Invalid operands for ADDI");
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid register in ADDI instruction");
-    }
-    int32_t imm = ops.immediate;
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
+template <class Policy>
+void CPU::writeRegister(size_t idx, int32_t value) {
+    if constexpr (Policy::checkBounds) setRegister(idx, value);
+    else registers_[idx] = value;
+}
+
+// Let the cache model see a data access
+template <class Policy>
+void CPU::observeAccess(uint32_t address, bool isWrite) {
+    if constexpr (Policy::profile) {
+        if (cache_) memoryStall_ = cache_->access(pc_, address, isWrite);
+        if (stats_) stats_->touch(address);
     }
-    setRegister(rd, getRegister(rs1) + imm);
 }
 
-void CPU::executeLI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    if (rd == -1) {
-        throw std::runtime_error("Invalid register in LI instruction");
+// Store width bytes, reporting the store when it hits a watchpoint
+template <class Policy>
+void CPU::storeMemory(uint32_t address, uint32_t width, int32_t value) {
+    if constexpr (Policy::profile) {
+        if (session_) session_->recordStore(address, width);
     }
-    int32_t imm = ops.immediate;
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
+    if constexpr (Policy::watch) {
+        if (watches_ && watches_->mayHit(address, width)) {
+            if (watches_->overlaps(address, width)) {
+                bool hadValue = true;
+                int32_t oldValue = 0;
+                try {
+                    oldValue = loadSized(address, width);
+                } catch (const std::runtime_error&) {
+                    hadValue = false; // first write to this address
+                }
+                storeSized(address, width, value);
+                watches_->notify({{}, pc_, address, width, hadValue, oldValue,
+                                  loadSized(address, width), memory_->getSourceLine(pc_)});
+                return;
+            }
+        }
     }
-    setRegister(rd, imm);
+    storeSized(address, width, value);
 }
 
-void CPU::executeSW(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid register in SW instruction");
-    }
-    uint32_t address = ops.immediate + getRegister(rs1);
-    memory_->store(address, getRegister(rd));
+int32_t CPU::loadSized(uint32_t address, uint32_t width) const {
+    if (width == 1) return memory_->loadByte(address);
+    if (width == 2) return memory_->loadHalf(address);
+    return memory_->load(address);
 }
 
-void CPU::executeLA(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    if (rd == -1) {
-        throw std::runtime_error("Invalid register in LA instruction");
-    }
-    uint32_t address = memory_->getVariableAddress(ops.var);
-    setRegister(rd, address);
+void CPU::storeSized(uint32_t address, uint32_t width, int32_t value) {
+    if (width == 1) memory_->storeByte(address, value & 0xFF);
+    else if (width == 2) memory_->storeHalf(address, value & 0xFFFF);
+    else memory_->store(address, value);
 }
 
-void CPU::executeBEQ(const Operands& ops) {
-    int32_t rs1 = registerindex(ops.rd);
-    int32_t rs2 = registerindex(ops.rs1);
-    if (rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid register in BEQ instruction");
-    }
-    if (getRegister(rs1) == getRegister(rs2)) {
-        pc_ += ops.immediate; // Branch taken
-    }
+// Logics for executing various instructions
+template <class Policy>
+void CPU::executeADD(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) + readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeBNE(const Operands& ops) {
-    int32_t rs1 = registerindex(ops.rd);
-    int32_t rs2 = registerindex(ops.rs1);
-    if (rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid register in BNE instruction");
-    }
-    if (getRegister(rs1) != getRegister(rs2)) {
-        pc_ += ops.immediate; // Branch taken
-    }
+template <class Policy>
+void CPU::executeSUB(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) - readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeLW(const Operands& ops) {
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rs1 == -1) {
-        throw std::runtime_error("Invalid register in LW instruction");
-    }
-    uint32_t address = ops.immediate + getRegister(rs1);
-    setRegister(registerindex(ops.rd), memory_->load(address));
+// Also executes LI, which is encoded as ADDI rd, x0, imm
+template <class Policy>
+void CPU::executeADDI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) + inst.imm);
 }
 
-void CPU::executeLUI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    if (rd == -1) {
-        throw std::runtime_error("Invalid register in LUI instruction");
-    }
-    setRegister(rd, ops.immediate << 12); // Load upper immediate
+template <class Policy>
+void CPU::executeSW(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, true);
+    storeMemory<Policy>(address, 4, readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeAUIPC(const Operands& ops, uint32_t& PC) {
-    int32_t rd = registerindex(ops.rd);
-    if (rd == -1) {
-        throw std::runtime_error("Invalid register in AUIPC instruction");
-    }
-    setRegister(rd, PC + (ops.immediate << 12)); // Add PC to immediate
+template <class Policy>
+void CPU::executeLA(const DecodedInstruction& inst) {
+    uint32_t address = memory_->getVariableAddress(memory_->getSymbolRef(inst.imm));
+    writeRegister<Policy>(inst.rd, address);
 }
 
-void CPU::executeAND(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for AND");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) & getRegister(rs2));
+template <class Policy>
+void CPU::executeBEQ(const DecodedInstruction& inst) {
+    branch<Policy>(readRegister<Policy>(inst.rs1) == readRegister<Policy>(inst.rs2), inst.imm);
 }
 
-void CPU::executeOR(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for OR");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) | getRegister(rs2));
+template <class Policy>
+void CPU::executeBNE(const DecodedInstruction& inst) {
+    branch<Policy>(readRegister<Policy>(inst.rs1) != readRegister<Policy>(inst.rs2), inst.imm);
 }
 
-void CPU::executeXOR(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for XOR");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) ^ getRegister(rs2));
+// Common tail of the conditional branches: report the outcome, then redirect the PC
+template <class Policy>
+void CPU::branch(bool taken, int32_t offset) {
+    if constexpr (Policy::profile)
+        mispredicted_ = predictors_ ? predictors_->record(pc_, offset < 0, taken) : taken;
+    if (taken) pc_ += offset; // Branch taken
 }
 
-void CPU::executeANDI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid operands for ANDI");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) & ops.immediate);
+template <class Policy>
+void CPU::executeLW(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, false);
+    writeRegister<Policy>(inst.rd, memory_->load(address));
 }
 
-void CPU::executeSLL(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for SLL");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) << getRegister(rs2));
+template <class Policy>
+void CPU::executeLUI(const DecodedInstruction& inst) {
+    writeRegister<Policy>(inst.rd, inst.imm); // Load upper immediate (already shifted by 12)
 }
 
-void CPU::executeSRL(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for SRL");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, static_cast<uint32_t>(getRegister(rs1)) >> getRegister(rs2));
+template <class Policy>
+void CPU::executeAUIPC(const DecodedInstruction& inst, uint32_t& PC) {
+    writeRegister<Policy>(inst.rd, memory_->codeAddress(PC) + inst.imm); // Add PC to upper immediate
 }
 
-void CPU::executeSRA(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for SRA");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) >> getRegister(rs2));
+template <class Policy>
+void CPU::executeAND(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) & readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeJALR(const Operands& ops, uint32_t& PC) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid operands for JALR");
-    }
-    setRegister(rd, PC + 4); // Save return address
-    PC = (getRegister(rs1) + ops.immediate) & ~1; // Jump to target address
+template <class Policy>
+void CPU::executeOR(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) | readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeJAL(const Operands& ops, uint32_t& PC) {
-    int32_t rd = registerindex(ops.rd);
-    if (rd == -1) {
-        throw std::runtime_error("Invalid register in JAL instruction");
-    }
-    setRegister(rd, PC + 4); // Save return address
-    PC += ops.immediate; // Jump to target address
+template <class Policy>
+void CPU::executeXOR(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) ^ readRegister<Policy>(inst.rs2));
 }
 
-void CPU::executeSRAI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid operands for SRAI");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) >> ops.immediate);
+template <class Policy>
+void CPU::executeANDI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) & inst.imm);
 }
 
-void CPU::executeSLLI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid operands for SLLI");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) << ops.immediate);
+// Register shifts use the low 5 bits of rs2, as in RV32I
+template <class Policy>
+void CPU::executeSLL(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) << (readRegister<Policy>(inst.rs2) & 0x1F));
 }
 
-void CPU::executeSRLI(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    if (rd == -1 || rs1 == -1) {
-        throw std::runtime_error("Invalid operands for SRLI");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, static_cast<uint32_t>(getRegister(rs1)) >> ops.immediate);
+template <class Policy>
+void CPU::executeSRL(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) >> (readRegister<Policy>(inst.rs2) & 0x1F));
 }
 
-void CPU::executeBGE(const Operands& ops) {
-    int32_t rs1 = registerindex(ops.rd);
-    int32_t rs2 = registerindex(ops.rs1);
-    if (rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid register in BGE instruction");
-    }
-    if (getRegister(rs1) >= getRegister(rs2)) {
-        pc_ += ops.immediate; // Branch taken
-    }
+template <class Policy>
+void CPU::executeSRA(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) >> (readRegister<Policy>(inst.rs2) & 0x1F));
 }
 
-void CPU::executeBLT(const Operands& ops) {
-    int32_t rs1 = registerindex(ops.rd);
-    int32_t rs2 = registerindex(ops.rs1);
-    if (rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid register in BLT instruction");
-    }
-    if (getRegister(rs1) < getRegister(rs2)) {
-        pc_ += ops.immediate; // Branch taken
-    }
+template <class Policy>
+void CPU::executeJALR(const DecodedInstruction& inst, uint32_t& PC) {
+    uint32_t target = (readRegister<Policy>(inst.rs1) + inst.imm) & ~1; // read rs1 before rd is written
+    writeRegister<Policy>(inst.rd, memory_->codeAddress(PC) + 4); // Save return address
+    PC = memory_->codeIndex(target); // Jump to target address
 }
 
-void CPU::executeMUL(const Operands& ops) {
-    int32_t rd = registerindex(ops.rd);
-    int32_t rs1 = registerindex(ops.rs1);
-    int32_t rs2 = registerindex(ops.rs2);
-    if (rd == -1 || rs1 == -1 || rs2 == -1) {
-        throw std::runtime_error("Invalid operands for MUL");
-    }
-    if (rd == 0) {
-        throw std::runtime_error("Invalid Input! Can't modify register x0");
-    }
-    setRegister(rd, getRegister(rs1) * getRegister(rs2));
+template <class Policy>
+void CPU::executeJAL(const DecodedInstruction& inst, uint32_t& PC) {
+    writeRegister<Policy>(inst.rd, memory_->codeAddress(PC) + 4); // Save return address
+    PC += inst.imm; // Jump to target address
+}
+
+template <class Policy>
+void CPU::executeSRAI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) >> inst.imm);
+}
+
+template <class Policy>
+void CPU::executeSLLI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) << inst.imm);
+}
+
+template <class Policy>
+void CPU::executeSRLI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) >> inst.imm);
+}
+
+template <class Policy>
+void CPU::executeBGE(const DecodedInstruction& inst) {
+    branch<Policy>(readRegister<Policy>(inst.rs1) >= readRegister<Policy>(inst.rs2), inst.imm);
+}
+
+template <class Policy>
+void CPU::executeBLT(const DecodedInstruction& inst) {
+    branch<Policy>(readRegister<Policy>(inst.rs1) < readRegister<Policy>(inst.rs2), inst.imm);
+}
+
+template <class Policy>
+void CPU::executeMUL(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) * readRegister<Policy>(inst.rs2));
+}
+
+template <class Policy>
+void CPU::executeSLT(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) < readRegister<Policy>(inst.rs2));
+}
+
+template <class Policy>
+void CPU::executeSLTU(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) < static_cast<uint32_t>(readRegister<Policy>(inst.rs2)));
+}
+
+template <class Policy>
+void CPU::executeSLTI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) < inst.imm);
+}
+
+template <class Policy>
+void CPU::executeSLTIU(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) < static_cast<uint32_t>(inst.imm));
+}
+
+template <class Policy>
+void CPU::executeXORI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) ^ inst.imm);
+}
+
+template <class Policy>
+void CPU::executeORI(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    writeRegister<Policy>(inst.rd, readRegister<Policy>(inst.rs1) | inst.imm);
+}
+
+template <class Policy>
+void CPU::executeBLTU(const DecodedInstruction& inst) {
+    branch<Policy>(static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) < static_cast<uint32_t>(readRegister<Policy>(inst.rs2)), inst.imm);
+}
+
+template <class Policy>
+void CPU::executeBGEU(const DecodedInstruction& inst) {
+    branch<Policy>(static_cast<uint32_t>(readRegister<Policy>(inst.rs1)) >= static_cast<uint32_t>(readRegister<Policy>(inst.rs2)), inst.imm);
+}
+
+// Sub-word loads sign (LB, LH) or zero (LBU, LHU) extend into rd
+template <class Policy>
+void CPU::executeLB(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, false);
+    writeRegister<Policy>(inst.rd, static_cast<int8_t>(memory_->loadByte(address)));
+}
+
+template <class Policy>
+void CPU::executeLH(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, false);
+    writeRegister<Policy>(inst.rd, static_cast<int16_t>(memory_->loadHalf(address)));
+}
+
+template <class Policy>
+void CPU::executeLBU(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, false);
+    writeRegister<Policy>(inst.rd, memory_->loadByte(address));
+}
+
+template <class Policy>
+void CPU::executeLHU(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, false);
+    writeRegister<Policy>(inst.rd, memory_->loadHalf(address));
+}
+
+template <class Policy>
+void CPU::executeSB(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, true);
+    storeMemory<Policy>(address, 1, readRegister<Policy>(inst.rs2));
+}
+
+template <class Policy>
+void CPU::executeSH(const DecodedInstruction& inst) {
+    uint32_t address = inst.imm + readRegister<Policy>(inst.rs1);
+    observeAccess<Policy>(address, true);
+    storeMemory<Policy>(address, 2, readRegister<Policy>(inst.rs2));
+}
+
+// System calls: number in a7, arguments in a0..a2, result in a0.
+// The print services use the RARS/SPIM numbers, write and exit the Linux ones;
+// all console output goes through the buffered console.
+void CPU::executeECALL() {
+    const int32_t PRINT_INT = 1, PRINT_STRING = 4, EXIT = 10, PRINT_CHAR = 11;
+    const int32_t SYS_WRITE = 64, SYS_EXIT = 93, SYS_EXIT_GROUP = 94;
+    const int32_t BAD_FILE = -9, NO_SYSCALL = -38; // -EBADF, -ENOSYS
+    int32_t a0 = getRegister(10);
+    switch (getRegister(17)) {
+        case PRINT_INT:
+            console_.putInt(a0);
+            break;
+        case PRINT_CHAR:
+            console_.putChar(static_cast<char>(a0));
+            break;
+        case PRINT_STRING: // NUL-terminated, bytes are little-endian parts of the data words
+            for (uint32_t address = a0; ; ++address) {
+                char c = static_cast<char>(memory_->loadByte(address));
+                if (c == '\0') break;
+                console_.putChar(c);
+            }
+            break;
+        case EXIT:
+            halt();
+            break;
+        case SYS_EXIT:
+        case SYS_EXIT_GROUP:
+            exitCode_ = a0;
+            halt();
+            break;
+        case SYS_WRITE: {
+            if (a0 != 1 && a0 != 2) { setRegister(10, BAD_FILE); break; }
+            uint32_t buffer = getRegister(11);
+            uint32_t length = getRegister(12);
+            if (a0 == 2) console_.flush(); // keep stdout and stderr output in program order
+            // Copied in chunks: the length comes from the guest and may be anything
+            char chunk[4096];
+            for (uint32_t done = 0; done < length;) {
+                uint32_t count = std::min<uint32_t>(length - done, sizeof(chunk));
+                for (uint32_t i = 0; i < count; ++i) chunk[i] = static_cast<char>(memory_->loadByte(buffer + done + i));
+                if (a0 == 1) console_.write(chunk, count);
+                else diagnostics_->write(chunk, count);
+                done += count;
+            }
+            setRegister(10, static_cast<int32_t>(length));
+            break;
+        }
+        default:
+            setRegister(10, NO_SYSCALL);
+    }
+}
+
+// Stop the program: step() sees the PC past the last instruction
+void CPU::halt() {
+    pc_ = memory_->instructionCount();
+    stopped_ = true;
+}
+
+template <class Policy>
+void CPU::executeCounterRead(const DecodedInstruction& inst) {
+    checkDestination<Policy>(inst.rd);
+    uint64_t value = 0;
+    switch (inst.opcode) {
+        case Opcode::RDCYCLE:   case Opcode::RDCYCLEH:   value = getCycles();  break;
+        case Opcode::RDTIME:    case Opcode::RDTIMEH:    value = getTime();    break;
+        case Opcode::RDINSTRET: case Opcode::RDINSTRETH: value = getInstret(); break;
+        default: break;
+    }
+    bool high = inst.opcode == Opcode::RDCYCLEH || inst.opcode == Opcode::RDTIMEH || inst.opcode == Opcode::RDINSTRETH;
+    writeRegister<Policy>(inst.rd, static_cast<int32_t>(high ? value >> 32 : value));
+}
+
+uint64_t CPU::getCycles() const {
+    return timing_ ? timing_->getCycles() : getInstret();
+}
+
+uint64_t CPU::getTime() const {
+    auto elapsed = std::chrono::steady_clock::now() - startTime_;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+// One "name value" line per counter, like the data output
+void CPU::saveCountersToFile(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("Failed to open counter file.");
+    out << "cycle " << getCycles() << "\n";
+    out << "instret " << getInstret() << "\n";
+    out << "time " << getTime() << "\n";
 }
@@ -1,19 +1,106 @@
 #pragma once
 #include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
 #include <string>
 #include "Memory.h"
 #include "Instruction.h"
+#include "Encoding.h"
+#include "Cache.h"
+#include "Pipeline.h"
+#include "BranchPredictor.h"
+#include "Console.h"
+#include "Watchpoint.h"
+#include "RunStats.h"
+
+// Compile-time configuration of the execution loop. Each engine is a separate
+// instantiation of CPU::stepEngine, so a feature its policy turns off is
+// compiled out: no flag test and no call is left for it.
+struct CheckedPolicy {
+    static constexpr bool checkBounds = true; // register index range checks
+    static constexpr bool enforceX0 = true;   // ALU writes to x0 are errors (text programs)
+    static constexpr bool trace = false;      // print every instruction and the registers
+    static constexpr bool profile = true;     // feed the attached cache/timing/predictor models
+    static constexpr bool watch = true;       // test stores against the attached watchpoints
+};
+
+struct TracePolicy : CheckedPolicy {
+    static constexpr bool trace = true;
+};
+
+struct FastPolicy {
+    static constexpr bool checkBounds = false;
+    static constexpr bool enforceX0 = false;
+    static constexpr bool trace = false;
+    static constexpr bool profile = false;
+    static constexpr bool watch = false;
+};
+
+// Execution engine picked at runtime; CHECKED is the default
+enum class Engine { CHECKED, TRACE, FAST };
+
+class IncrementalSession;
 
 class CPU {
 public:
+    // Architectural state, saved and restored by incremental re-execution
+    struct State {
+        std::array<int32_t, 32> registers;
+        uint32_t pc;
+        uint64_t retiredBase;
+        uint32_t blockStart;
+        int32_t exitCode;
+        bool halted; // ended by ECALL/EBREAK; the PC then depends on the program length
+    };
+
     // Constructors
     CPU(std::string& instructionFile, std::string& dataFile);
     CPU();
 
+    // Load a statically linked RV32I ELF executable and point PC/sp at it
+    void loadElf(const std::string& filename);
+
     // To run the program
     void run();
     bool step();
 
+    // Back to the state before the first instruction: registers, counters and
+    // exit status are cleared, the PC is the entry point (0 for text, the ELF
+    // entry with sp set up for ELF) and the x0 check follows the loaded program
+    // (on for text, off for ELF). Memory is left as it is.
+    void reset();
+    State saveState() const { return {registers_, pc_, retiredBase_, blockStart_, exitCode_, stopped_}; }
+    void restoreState(const State& state);
+
+    // Engine used by run() and step(). FAST gives the same results for programs
+    // that run without errors under CHECKED, but ignores attached models and does
+    // not report writes to x0.
+    void setEngine(Engine engine) { engine_ = engine; }
+    Engine getEngine() const { return engine_; }
+
+    // Execute at most maxInstructions and return how many ran; fewer means
+    // the program has finished. Lets a scheduler time-slice many CPUs.
+    uint64_t runSlice(uint64_t maxInstructions);
+
+    // Stop run() after this many instructions (0 = no limit)
+    void setInstructionBudget(uint64_t budget) { budget_ = budget; }
+    bool budgetExhausted() const { return budgetExhausted_; }
+
+    // The next step() would not execute anything: the program has ended
+    bool halted() const;
+
+    // Status passed to the exit ECALL by the program
+    int32_t getExitCode() const { return exitCode_; }
+
+    // Performance counters, as read by RDCYCLE/RDINSTRET/RDTIME.
+    // Cycles come from the pipeline model when one is attached, otherwise one per instruction.
+    // Time is in microseconds since run() started.
+    uint64_t getCycles() const;
+    uint64_t getInstret() const { return retiredBase_ + (pc_ - blockStart_); }
+    uint64_t getTime() const;
+    void saveCountersToFile(const std::string& filename) const;
+
     // Register access for executing instructions
     int32_t getRegister(size_t idx) const;
     void setRegister(size_t idx, int32_t value);
@@ -22,48 +109,125 @@ public:
     uint32_t getPC() const;
 
     // Print registers (for debug)
-    void printRegisters() const;
+    void printRegisters(std::ostream& out = std::cout) const;
 
     // Get the memory object to store and retrieve data
-    Memory* getMemory() const { return memory_; }
+    Memory* getMemory() const { return memory_.get(); }
+
+    // Buffered output of the print ECALLs (stdout unless redirected)
+    Console& getConsole() { return console_; }
+    const Console& getConsole() const { return console_; }
+
+    // Where the trace and writes to stderr go (std::cerr by default)
+    void setDiagnosticOutput(std::ostream& out) { diagnostics_ = &out; }
+
+    // Attach a cache model that observes every LW/SW (nullptr to detach)
+    void attachCache(CacheHierarchy* cache) { cache_ = cache; }
+
+    // Attach a pipeline timing model fed with every retired instruction (nullptr to detach)
+    void attachTiming(PipelineModel* timing) { timing_ = timing; }
+
+    // Attach branch predictors observing every conditional branch (nullptr to detach)
+    void attachBranchPredictors(BranchPredictorSet* predictors) { predictors_ = predictors; }
+
+    // Attach data watchpoints tested by every store (nullptr to detach; not seen by FAST)
+    void attachWatchpoints(WatchpointSet* watches) { watches_ = watches; }
+
+    // Attach run statistics counting executed instructions and touched data (nullptr to detach)
+    void attachStats(RunStats* stats) { stats_ = stats; }
+
+    // Attach an incremental session recording stores and checkpoints (nullptr to detach)
+    void attachSession(IncrementalSession* session) { session_ = session; }
 
 private:
-    // Execute a single instruction
-    void execute(const Instruction& inst);
-    
-    // Given a register name, return its index (0-31)
-    int32_t registerindex(std::string reg);
+    template <class Policy> void runEngine();
+    template <class Policy> uint64_t runSliceEngine(uint64_t maxInstructions);
+    template <class Policy> bool stepEngine();
+
+    // Execute a single decoded instruction
+    template <class Policy> void execute(const DecodedInstruction& inst);
+
+    // Most ALU instructions refuse to write x0 in text programs
+    template <class Policy> void checkDestination(uint8_t rd) const;
+
+    // Register and memory access of the executors, checked or observed as the policy says
+    template <class Policy> int32_t readRegister(size_t idx) const;
+    template <class Policy> void writeRegister(size_t idx, int32_t value);
+    template <class Policy> void observeAccess(uint32_t address, bool isWrite);
+    template <class Policy> void storeMemory(uint32_t address, uint32_t width, int32_t value);
+    int32_t loadSized(uint32_t address, uint32_t width) const;
+    void storeSized(uint32_t address, uint32_t width, int32_t value);
 
     // Implementation for each opcode
-    void executeADD(const Operands& ops);
-    void executeADDI(const Operands& ops);
-    void executeSUB(const Operands& ops);
-    void executeLI(const Operands& ops);
-    void executeSW(const Operands& ops);
-    void executeLA(const Operands& ops);
-    void executeBEQ(const Operands& ops);
-    void executeBNE(const Operands& ops);
-    void executeBGE(const Operands& ops);
-    void executeBLT(const Operands& ops);
-    void executeLW(const Operands& ops);
-    void executeLUI(const Operands& ops);
-    void executeAUIPC(const Operands& ops, uint32_t& PC);
-    void executeAND(const Operands& ops);
-    void executeOR(const Operands& ops);
-    void executeXOR(const Operands& ops);
-    void executeANDI(const Operands& ops);
-    void executeSLL(const Operands& ops);
-    void executeSRL(const Operands& ops);
-    void executeSRA(const Operands& ops);
-    void executeJALR(const Operands& ops, uint32_t& PC);
-    void executeJAL(const Operands& ops, uint32_t& PC);
-    void executeSLLI(const Operands& ops); 
-    void executeSRLI(const Operands& ops); 
-    void executeSRAI(const Operands& ops); 
-    void executeMUL(const Operands& ops); 
+    template <class Policy> void executeADD(const DecodedInstruction& inst);
+    template <class Policy> void executeADDI(const DecodedInstruction& inst);
+    template <class Policy> void executeSUB(const DecodedInstruction& inst);
+    template <class Policy> void executeSW(const DecodedInstruction& inst);
+    template <class Policy> void executeLA(const DecodedInstruction& inst);
+    template <class Policy> void executeBEQ(const DecodedInstruction& inst);
+    template <class Policy> void executeBNE(const DecodedInstruction& inst);
+    template <class Policy> void executeBGE(const DecodedInstruction& inst);
+    template <class Policy> void executeBLT(const DecodedInstruction& inst);
+    template <class Policy> void branch(bool taken, int32_t offset);
+    template <class Policy> void executeLW(const DecodedInstruction& inst);
+    template <class Policy> void executeLUI(const DecodedInstruction& inst);
+    template <class Policy> void executeAUIPC(const DecodedInstruction& inst, uint32_t& PC);
+    template <class Policy> void executeAND(const DecodedInstruction& inst);
+    template <class Policy> void executeOR(const DecodedInstruction& inst);
+    template <class Policy> void executeXOR(const DecodedInstruction& inst);
+    template <class Policy> void executeANDI(const DecodedInstruction& inst);
+    template <class Policy> void executeSLL(const DecodedInstruction& inst);
+    template <class Policy> void executeSRL(const DecodedInstruction& inst);
+    template <class Policy> void executeSRA(const DecodedInstruction& inst);
+    template <class Policy> void executeJALR(const DecodedInstruction& inst, uint32_t& PC);
+    template <class Policy> void executeJAL(const DecodedInstruction& inst, uint32_t& PC);
+    template <class Policy> void executeSLLI(const DecodedInstruction& inst); 
+    template <class Policy> void executeSRLI(const DecodedInstruction& inst); 
+    template <class Policy> void executeSRAI(const DecodedInstruction& inst); 
+    template <class Policy> void executeMUL(const DecodedInstruction& inst); 
+    template <class Policy> void executeSLT(const DecodedInstruction& inst);
+    template <class Policy> void executeSLTU(const DecodedInstruction& inst);
+    template <class Policy> void executeSLTI(const DecodedInstruction& inst);
+    template <class Policy> void executeSLTIU(const DecodedInstruction& inst);
+    template <class Policy> void executeXORI(const DecodedInstruction& inst);
+    template <class Policy> void executeORI(const DecodedInstruction& inst);
+    template <class Policy> void executeBLTU(const DecodedInstruction& inst);
+    template <class Policy> void executeBGEU(const DecodedInstruction& inst);
+    template <class Policy> void executeLB(const DecodedInstruction& inst);
+    template <class Policy> void executeLH(const DecodedInstruction& inst);
+    template <class Policy> void executeLBU(const DecodedInstruction& inst);
+    template <class Policy> void executeLHU(const DecodedInstruction& inst);
+    template <class Policy> void executeSB(const DecodedInstruction& inst);
+    template <class Policy> void executeSH(const DecodedInstruction& inst);
+    template <class Policy> void executeCounterRead(const DecodedInstruction& inst);
+    void executeECALL();
+    void halt();
     // ... (other opcodes)
 
     std::array<int32_t, 32> registers_; // RISC-V: 32 registers
     uint32_t pc_; // Program counter
-    Memory* memory_; // Memory containing instructions and data
+    uint32_t elfEntry_ = 0; // PC and sp an ELF program starts with
+    uint32_t elfStackPointer_ = 0;
+    std::unique_ptr<Memory> memory_; // Memory containing instructions and data
+    CacheHierarchy* cache_ = nullptr; // Optional data cache model
+    PipelineModel* timing_ = nullptr; // Optional pipeline timing model
+    BranchPredictorSet* predictors_ = nullptr; // Optional branch predictors
+    WatchpointSet* watches_ = nullptr; // Optional data watchpoints
+    RunStats* stats_ = nullptr; // Optional execution statistics
+    IncrementalSession* session_ = nullptr; // Optional undo log and checkpoints
+    uint32_t memoryStall_ = 0; // Cache stall cycles of the current instruction
+    bool mispredicted_ = false; // Current branch was mispredicted (taken, without predictors)
+    bool enforceX0_ = true; // Reject ALU writes to x0 (text programs only)
+    int32_t exitCode_ = 0;
+    bool stopped_ = false; // halt() was called: ECALL exit or EBREAK
+    Console console_{std::cout};
+    std::ostream* diagnostics_ = &std::cerr;
+    // instret is only updated at taken control transfers: retiredBase_ counts the
+    // instructions before blockStart_, the straight-line run since then is pc_ - blockStart_
+    uint64_t retiredBase_ = 0;
+    uint32_t blockStart_ = 0;
+    std::chrono::steady_clock::time_point startTime_ = std::chrono::steady_clock::now();
+    Engine engine_ = Engine::CHECKED;
+    uint64_t budget_ = 0; // Instruction limit of run(), 0 for none
+    bool budgetExhausted_ = false; // run() stopped at the limit
 };
@@ -0,0 +1,199 @@
+#include "Cache.h"
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <stdexcept>
+
+static const uint8_t VALID = 1;
+static const uint8_t DIRTY = 2;
+
+static bool isPowerOfTwo(uint32_t x) { return x && !(x & (x - 1)); }
+
+static uint32_t log2u(uint32_t x) {
+    uint32_t bits = 0;
+    while (x >>= 1) ++bits;
+    return bits;
+}
+
+// Parses a plain decimal number that fits in 32 bits
+static uint32_t parseCount(const std::string& s) {
+    if (s.empty() || s.size() > 10 || s.find_first_not_of("0123456789") != std::string::npos
+        || std::stoull(s) > UINT32_MAX)
+        throw std::invalid_argument(s);
+    return static_cast<uint32_t>(std::stoul(s));
+}
+
+// Parses a size such as "4096", "32K" or "1M"
+static uint32_t parseSize(const std::string& s) {
+    uint32_t shift = 0;
+    if (!s.empty() && (s.back() == 'K' || s.back() == 'k')) shift = 10;
+    else if (!s.empty() && (s.back() == 'M' || s.back() == 'm')) shift = 20;
+    uint64_t value = parseCount(shift ? s.substr(0, s.size() - 1) : s);
+    if (value > (UINT32_MAX >> shift)) throw std::out_of_range(s);
+    return static_cast<uint32_t>(value << shift);
+}
+
+// Parses a cache spec like "32K:4:64" or "256K:8:64:10"
+CacheConfig parseCacheConfig(const std::string& spec, uint32_t defaultLatency) {
+    std::vector<std::string> fields(1);
+    for (char c : spec) {
+        if (c == ':') fields.emplace_back();
+        else fields.back() += c;
+    }
+    if (fields.size() != 3 && fields.size() != 4)
+        throw std::runtime_error("Invalid cache spec (expected SIZE:ASSOC:LINE[:LATENCY]): " + spec);
+    CacheConfig config;
+    try {
+        config.size = parseSize(fields[0]);
+        config.associativity = parseCount(fields[1]);
+        config.lineSize = parseSize(fields[2]);
+        config.latency = fields.size() == 4 ? parseCount(fields[3]) : defaultLatency;
+    } catch (const std::logic_error&) {
+        throw std::runtime_error("Invalid cache spec: " + spec);
+    }
+    return config;
+}
+
+CacheLevel::CacheLevel(const std::string& name, const CacheConfig& config,
+                       ReplacementPolicy replacement, WritePolicy write)
+    : name_(name), config_(config), replacement_(replacement), write_(write) {
+    if (!isPowerOfTwo(config.lineSize) || config.lineSize < 4)
+        throw std::runtime_error(name + ": line size must be a power of two >= 4");
+    if (config.associativity == 0 || config.size % (config.associativity * config.lineSize) != 0)
+        throw std::runtime_error(name + ": size must be a multiple of associativity * line size");
+    uint32_t sets = config.size / (config.associativity * config.lineSize);
+    if (!isPowerOfTwo(sets))
+        throw std::runtime_error(name + ": number of sets must be a power of two");
+
+    offsetBits_ = log2u(config.lineSize);
+    setMask_ = sets - 1;
+    ways_ = config.associativity;
+    tags_.assign(static_cast<size_t>(sets) * ways_, 0);
+    stamps_.assign(tags_.size(), 0);
+    state_.assign(tags_.size(), 0);
+}
+
+uint32_t CacheLevel::chooseVictim(size_t base) {
+    if (replacement_ == ReplacementPolicy::RANDOM) {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return rng_ % ways_;
+    }
+    uint32_t victim = 0;
+    for (uint32_t w = 1; w < ways_; ++w)
+        if (stamps_[base + w] < stamps_[base + victim]) victim = w;
+    return victim;
+}
+
+bool CacheLevel::access(uint32_t address, bool isWrite, bool& wroteBack, uint32_t& victim) {
+    uint32_t line = address >> offsetBits_;
+    size_t base = static_cast<size_t>(line & setMask_) * ways_;
+    wroteBack = false;
+    ++clock_;
+
+    for (uint32_t w = 0; w < ways_; ++w) {
+        size_t i = base + w;
+        if ((state_[i] & VALID) && tags_[i] == line) {
+            ++hits_;
+            stamps_[i] = clock_;
+            if (isWrite && write_ == WritePolicy::WRITE_BACK) state_[i] |= DIRTY;
+            return true;
+        }
+    }
+
+    ++misses_;
+    if (isWrite && write_ == WritePolicy::WRITE_THROUGH) return false; // no write-allocate
+
+    // Prefer an empty way, otherwise evict according to the replacement policy
+    uint32_t way = ways_;
+    for (uint32_t w = 0; w < ways_; ++w) {
+        if (!(state_[base + w] & VALID)) { way = w; break; }
+    }
+    if (way == ways_) way = chooseVictim(base);
+
+    size_t i = base + way;
+    if ((state_[i] & (VALID | DIRTY)) == (VALID | DIRTY)) {
+        wroteBack = true;
+        victim = tags_[i] << offsetBits_;
+        ++writeBacks_;
+    }
+    tags_[i] = line;
+    stamps_[i] = clock_;
+    state_[i] = VALID | ((isWrite && write_ == WritePolicy::WRITE_BACK) ? DIRTY : 0);
+    return false;
+}
+
+void CacheLevel::report(std::ostream& out) const {
+    uint64_t accesses = getAccesses();
+    double missRate = accesses ? 100.0 * misses_ / accesses : 0.0;
+    std::ios_base::fmtflags flags = out.flags(); // the caller's formatting is restored below
+    std::streamsize precision = out.precision();
+    out << name_ << ": " << accesses << " accesses, " << hits_ << " hits, " << misses_ << " misses ("
+        << std::fixed << std::setprecision(2) << missRate << "% miss rate), "
+        << writeBacks_ << " write-backs\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+CacheHierarchy::CacheHierarchy(const CacheConfig& l1, ReplacementPolicy replacement,
+                               WritePolicy write, uint32_t memoryLatency)
+    : replacement_(replacement), write_(write), memoryLatency_(memoryLatency) {
+    levels_.push_back(std::make_unique<CacheLevel>("L1", l1, replacement, write));
+}
+
+void CacheHierarchy::addL2(const CacheConfig& l2) {
+    if (levels_.size() != 1) throw std::runtime_error("L2 already configured");
+    levels_.push_back(std::make_unique<CacheLevel>("L2", l2, replacement_, write_));
+}
+
+uint32_t CacheHierarchy::accessBelow(size_t idx, uint32_t address, bool isWrite) {
+    if (idx == levels_.size()) {
+        ++memoryAccesses_;
+        return memoryLatency_;
+    }
+    CacheLevel& level = *levels_[idx];
+    bool wroteBack;
+    uint32_t victim = 0;
+    uint32_t cycles = level.getLatency();
+    bool hit = level.access(address, isWrite, wroteBack, victim);
+    bool writeThrough = isWrite && level.getWritePolicy() == WritePolicy::WRITE_THROUGH;
+    if (!hit && !writeThrough) cycles += accessBelow(idx + 1, address, false); // line fill
+    if (wroteBack) cycles += accessBelow(idx + 1, victim, true);
+    if (writeThrough) cycles += accessBelow(idx + 1, address, true);
+    return cycles;
+}
+
+uint32_t CacheHierarchy::access(uint32_t pc, uint32_t address, bool isWrite) {
+    CacheLevel& l1 = *levels_[0];
+    uint64_t missesBefore = l1.getMisses();
+    uint32_t stall = accessBelow(0, address, isWrite) - l1.getLatency();
+    if (l1.getMisses() != missesBefore) {
+        if (pc >= missesByPC_.size()) missesByPC_.resize(pc + 1, 0);
+        ++missesByPC_[pc];
+    }
+    stallCycles_ += stall;
+    return stall;
+}
+
+void CacheHierarchy::report(std::ostream& out, size_t topPCs) const {
+    out << "\n==== Cache statistics ====\n";
+    for (const auto& level : levels_) level->report(out);
+    out << "Memory: " << memoryAccesses_ << " accesses\n";
+    out << "Estimated memory stall cycles: " << stallCycles_ << "\n";
+    if (write_ == WritePolicy::WRITE_THROUGH)
+        out << "  (write-through: no write buffer is modelled, every store stalls for the levels below)\n";
+
+    std::vector<std::pair<uint64_t, uint32_t>> byPC; // (misses, pc)
+    for (uint32_t pc = 0; pc < missesByPC_.size(); ++pc)
+        if (missesByPC_[pc]) byPC.emplace_back(missesByPC_[pc], pc);
+    std::sort(byPC.begin(), byPC.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    if (byPC.size() > topPCs) byPC.resize(topPCs);
+    if (!byPC.empty()) out << "L1 misses by PC:\n";
+    std::ios_base::fmtflags flags = out.flags();
+    for (const auto& [misses, pc] : byPC)
+        out << "  PC " << std::left << std::setw(6) << pc << misses << "\n";
+    out.flags(flags);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class ReplacementPolicy { LRU, RANDOM };
+enum class WritePolicy { WRITE_BACK, WRITE_THROUGH };
+
+// Geometry and timing of one cache level, sizes in bytes
+struct CacheConfig {
+    uint32_t size;           // total capacity
+    uint32_t associativity;  // ways per set
+    uint32_t lineSize;       // bytes per line
+    uint32_t latency;        // cycles to service an access at this level
+};
+
+// Parses "SIZE:ASSOC:LINE[:LATENCY]", e.g. "32K:4:64" or "256K:8:64:10"
+CacheConfig parseCacheConfig(const std::string& spec, uint32_t defaultLatency);
+
+// A single set-associative cache level.
+// Tags, LRU stamps and state bits live in flat arrays indexed by set * ways + way.
+class CacheLevel {
+public:
+    CacheLevel(const std::string& name, const CacheConfig& config,
+               ReplacementPolicy replacement, WritePolicy write);
+
+    // Look up the line holding address, filling it on a miss (write misses
+    // are not allocated under write-through). Returns true on hit.
+    // If a dirty line had to be evicted, wroteBack is set and victim holds its address.
+    bool access(uint32_t address, bool isWrite, bool& wroteBack, uint32_t& victim);
+    WritePolicy getWritePolicy() const { return write_; }
+
+    const std::string& getName() const { return name_; }
+    uint32_t getLatency() const { return config_.latency; }
+    uint64_t getAccesses() const { return hits_ + misses_; }
+    uint64_t getHits() const { return hits_; }
+    uint64_t getMisses() const { return misses_; }
+    uint64_t getWriteBacks() const { return writeBacks_; }
+
+    void report(std::ostream& out) const;
+
+private:
+    uint32_t chooseVictim(size_t base);
+
+    std::string name_;
+    CacheConfig config_;
+    ReplacementPolicy replacement_;
+    WritePolicy write_;
+
+    uint32_t offsetBits_;  // log2(lineSize)
+    uint32_t setMask_;     // numSets - 1
+    uint32_t ways_;
+
+    std::vector<uint32_t> tags_;    // line address (address >> offsetBits_)
+    std::vector<uint64_t> stamps_;  // last use, for LRU
+    std::vector<uint8_t> state_;    // VALID / DIRTY bits
+    uint64_t clock_ = 0;
+    uint32_t rng_ = 2463534242u;    // xorshift state for RANDOM replacement
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t writeBacks_ = 0;
+};
+
+// L1 (and optionally L2) in front of main memory.
+// Observes every data access made by LW/SW and accumulates stall cycles:
+// the cycles an access spends beyond an L1 hit.
+class CacheHierarchy {
+public:
+    CacheHierarchy(const CacheConfig& l1, ReplacementPolicy replacement,
+                   WritePolicy write, uint32_t memoryLatency);
+
+    // Add an L2 between L1 and main memory
+    void addL2(const CacheConfig& l2);
+
+    // Record one data access issued by the instruction at pc.
+    // Returns the stall cycles incurred by the access.
+    uint32_t access(uint32_t pc, uint32_t address, bool isWrite);
+
+    uint64_t getStallCycles() const { return stallCycles_; }
+
+    // Print hit/miss rates, stall cycles and the PCs with the most L1 misses
+    void report(std::ostream& out, size_t topPCs = 10) const;
+
+private:
+    // Service an access that missed in (or was written through) level idx
+    uint32_t accessBelow(size_t idx, uint32_t address, bool isWrite);
+
+    std::vector<std::unique_ptr<CacheLevel>> levels_;
+    ReplacementPolicy replacement_;
+    WritePolicy write_;
+    uint32_t memoryLatency_;
+    uint64_t memoryAccesses_ = 0;
+    uint64_t stallCycles_ = 0;
+    std::vector<uint64_t> missesByPC_; // L1 misses indexed by PC
+};
@@ -0,0 +1,53 @@
+#include "Console.h"
+#include <cstring>
+
+Console::Console(std::ostream& out, size_t capacity)
+    : out_(&out), buffer_(new char[capacity]), capacity_(capacity) {}
+
+Console::~Console() {
+    flush();
+}
+
+void Console::setOutput(std::ostream& out) {
+    flush();
+    out_ = &out;
+}
+
+void Console::write(const char* data, size_t length) {
+    if (used_ + length > capacity_) {
+        flush();
+        if (length > capacity_) { // too large to buffer, pass it straight through
+            out_->write(data, length);
+            written_ += length;
+            return;
+        }
+    }
+    std::memcpy(buffer_.get() + used_, data, length);
+    used_ += length;
+}
+
+void Console::putChar(char c) {
+    if (used_ == capacity_) flush();
+    buffer_[used_++] = c;
+}
+
+void Console::putInt(int32_t value) {
+    char digits[12];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+    do {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) *--p = '-';
+    write(p, end - p);
+}
+
+void Console::flush() {
+    if (used_ == 0) return;
+    out_->write(buffer_.get(), used_);
+    out_->flush();
+    written_ += used_;
+    used_ = 0;
+}
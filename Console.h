@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// Guest console output (print ECALLs, write to stdout).
+// Output is collected in a large host buffer and handed to the stream only
+// when the buffer is full or flush() is called (at exit), so printing costs
+// a memcpy per call rather than an I/O operation.
+class Console {
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+    explicit Console(std::ostream& out, size_t capacity = DEFAULT_CAPACITY);
+    ~Console();
+    Console(const Console&) = delete;
+    Console& operator=(const Console&) = delete;
+
+    // Where output goes from now on (the buffer is flushed to the old stream first)
+    void setOutput(std::ostream& out);
+
+    void write(const char* data, size_t length);
+    void putChar(char c);
+    void putInt(int32_t value);
+    void flush();
+
+    // Total bytes the guest has printed
+    uint64_t bytesWritten() const { return written_ + used_; }
+
+private:
+    std::ostream* out_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint64_t written_ = 0; // bytes already flushed
+};
@@ -0,0 +1,141 @@
+#include "ElfLoader.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifndef EM_RISCV
+#define EM_RISCV 243
+#endif
+#ifndef EF_RISCV_RVC
+#define EF_RISCV_RVC 0x1 // compressed instructions
+#endif
+
+namespace {
+
+
+// Read-only view of the whole file, released on scope exit
+struct MappedFile {
+    int fd = -1;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& filename) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open ELF file.");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Failed to read ELF file.");
+        }
+        size = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map ELF file.");
+        }
+        data = static_cast<const uint8_t*>(p);
+    }
+    ~MappedFile() {
+        munmap(const_cast<uint8_t*>(data), size);
+        close(fd);
+    }
+};
+
+void checkHeader(const MappedFile& file, const Elf32_Ehdr& eh) {
+    if (std::memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0) throw std::runtime_error("Not an ELF file.");
+    if (eh.e_ident[EI_CLASS] != ELFCLASS32 || eh.e_ident[EI_DATA] != ELFDATA2LSB)
+        throw std::runtime_error("Only 32-bit little-endian ELF files are supported.");
+    if (eh.e_machine != EM_RISCV) throw std::runtime_error("ELF file is not a RISC-V executable.");
+    if (eh.e_type != ET_EXEC) throw std::runtime_error("Only statically linked ELF executables are supported.");
+    if (eh.e_flags & EF_RISCV_RVC) throw std::runtime_error("Compressed (RVC) instructions are not supported.");
+    if (eh.e_phentsize != sizeof(Elf32_Phdr) ||
+        eh.e_phoff + uint64_t(eh.e_phnum) * sizeof(Elf32_Phdr) > file.size)
+        throw std::runtime_error("Invalid ELF program headers.");
+}
+
+} // namespace
+
+uint32_t loadElfExecutable(const std::string& filename, Memory& memory, uint32_t& stackPointer) {
+    MappedFile file(filename);
+    if (file.size < sizeof(Elf32_Ehdr)) throw std::runtime_error("Not an ELF file.");
+    Elf32_Ehdr eh;
+    std::memcpy(&eh, file.data, sizeof(eh));
+    checkHeader(file, eh);
+
+    const uint32_t page = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+    struct Segment {
+        Elf32_Phdr ph;
+        uint32_t start; // ph.p_vaddr and the end rounded to host pages
+        uint64_t end;
+    };
+    std::vector<Segment> segments;
+    for (uint32_t i = 0; i < eh.e_phnum; ++i) {
+        Elf32_Phdr ph;
+        std::memcpy(&ph, file.data + eh.e_phoff + i * sizeof(Elf32_Phdr), sizeof(ph));
+        if (ph.p_type != PT_LOAD || ph.p_memsz == 0) continue;
+        if (ph.p_filesz > ph.p_memsz || uint64_t(ph.p_offset) + ph.p_filesz > file.size)
+            throw std::runtime_error("Invalid ELF segment.");
+        uint32_t start = ph.p_vaddr & ~(page - 1);
+        uint64_t end = (uint64_t(ph.p_vaddr) + ph.p_memsz + page - 1) & ~uint64_t(page - 1);
+        if (end > 0x100000000ull) throw std::runtime_error("ELF segment outside the 32-bit address space.");
+        segments.push_back({ph, start, end});
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment& a, const Segment& b) { return a.ph.p_vaddr < b.ph.p_vaddr; });
+
+    bool haveText = false;
+    for (size_t first = 0; first < segments.size();) {
+        // Segments sharing a host page share one region: a page can only be mapped once
+        size_t last = first + 1;
+        uint64_t end = segments[first].end;
+        for (; last < segments.size() && segments[last].start < end; ++last) {
+            const Elf32_Phdr& previous = segments[last - 1].ph;
+            if (segments[last].ph.p_vaddr < uint64_t(previous.p_vaddr) + previous.p_memsz)
+                throw std::runtime_error("ELF segments overlap.");
+            end = std::max(end, segments[last].end);
+        }
+        uint32_t base = segments[first].start;
+        uint8_t* region = memory.addRegion(base, static_cast<uint32_t>(end - base));
+        bool shared = last - first > 1;
+
+        for (size_t i = first; i < last; ++i) {
+            const Elf32_Phdr& ph = segments[i].ph;
+            uint8_t* host = region + (segments[i].start - base);
+            uint32_t pageOffset = ph.p_vaddr - segments[i].start;
+            if (ph.p_filesz) {
+                if (!shared && (ph.p_offset - pageOffset) % page == 0 && ph.p_offset >= pageOffset) {
+                    // Map the file pages over the region; writes stay private to this process
+                    size_t length = pageOffset + ph.p_filesz;
+                    if (mmap(host, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                             file.fd, ph.p_offset - pageOffset) == MAP_FAILED)
+                        throw std::runtime_error("Failed to map ELF segment.");
+                    // Only the segment's own bytes come from the file
+                    std::memset(host, 0, pageOffset);
+                    size_t mappedEnd = (length + page - 1) & ~size_t(page - 1);
+                    std::memset(host + length, 0, mappedEnd - length);
+                } else {
+                    std::memcpy(host + pageOffset, file.data + ph.p_offset, ph.p_filesz);
+                }
+            }
+
+            if (ph.p_flags & PF_X) {
+                if (haveText) throw std::runtime_error("ELF files with several executable segments are not supported.");
+                memory.loadBinaryProgram(reinterpret_cast<const uint32_t*>(host + pageOffset), ph.p_filesz / 4, ph.p_vaddr);
+                haveText = true;
+            }
+        }
+        first = last;
+    }
+    if (!haveText) throw std::runtime_error("ELF file has no executable segment.");
+
+    // argc, argv and envp at the bottom of the stack frame are all zero
+    memory.addRegion(ELF_STACK_TOP - ELF_STACK_SIZE, ELF_STACK_SIZE);
+    stackPointer = ELF_STACK_TOP - 16;
+    return eh.e_entry;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Memory.h"
+
+// Top of the stack given to ELF programs, and its size
+const uint32_t ELF_STACK_TOP = 0x7FFFF000;
+const uint32_t ELF_STACK_SIZE = 1 << 20;
+
+// Load a statically linked little-endian RV32I ELF executable into memory.
+// Every PT_LOAD segment becomes a memory region: its file bytes are mapped
+// copy-on-write straight from the file when the offsets allow it (copied
+// otherwise) and .bss is anonymous zero pages. The executable segment also
+// becomes the program. A stack is mapped below ELF_STACK_TOP.
+// Returns the entry point; stackPointer receives the initial sp.
+uint32_t loadElfExecutable(const std::string& filename, Memory& memory, uint32_t& stackPointer);
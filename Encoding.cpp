@@ -0,0 +1,262 @@
+#include "Encoding.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+// How each opcode is laid out in a word
+struct EncodingInfo {
+    Opcode opcode;
+    Format format;
+    uint32_t major;
+    uint32_t funct3;
+    uint32_t funct7; // R-type, and the upper immediate bits of the shift-immediates
+};
+
+const EncodingInfo encodings[] = {
+    {Opcode::LUI,   Format::U, MajorOpcode::LUI,     0, 0},
+    {Opcode::AUIPC, Format::U, MajorOpcode::AUIPC,   0, 0},
+    {Opcode::LA,    Format::U, MajorOpcode::CUSTOM0, 0, 0},
+    {Opcode::NOP,   Format::U, MajorOpcode::CUSTOM1, 0, 0},
+    {Opcode::JAL,   Format::J, MajorOpcode::JAL,     0, 0},
+    {Opcode::JALR,  Format::I, MajorOpcode::JALR,    0, 0},
+
+    {Opcode::BEQ,  Format::B, MajorOpcode::BRANCH, 0, 0},
+    {Opcode::BNE,  Format::B, MajorOpcode::BRANCH, 1, 0},
+    {Opcode::BLT,  Format::B, MajorOpcode::BRANCH, 4, 0},
+    {Opcode::BGE,  Format::B, MajorOpcode::BRANCH, 5, 0},
+    {Opcode::BLTU, Format::B, MajorOpcode::BRANCH, 6, 0},
+    {Opcode::BGEU, Format::B, MajorOpcode::BRANCH, 7, 0},
+
+    {Opcode::LB,  Format::I, MajorOpcode::LOAD, 0, 0},
+    {Opcode::LH,  Format::I, MajorOpcode::LOAD, 1, 0},
+    {Opcode::LW,  Format::I, MajorOpcode::LOAD, 2, 0},
+    {Opcode::LBU, Format::I, MajorOpcode::LOAD, 4, 0},
+    {Opcode::LHU, Format::I, MajorOpcode::LOAD, 5, 0},
+    {Opcode::SB,  Format::S, MajorOpcode::STORE, 0, 0},
+    {Opcode::SH,  Format::S, MajorOpcode::STORE, 1, 0},
+    {Opcode::SW,  Format::S, MajorOpcode::STORE, 2, 0},
+
+    {Opcode::ADDI,  Format::I, MajorOpcode::OP_IMM, 0, 0},
+    {Opcode::SLTI,  Format::I, MajorOpcode::OP_IMM, 2, 0},
+    {Opcode::SLTIU, Format::I, MajorOpcode::OP_IMM, 3, 0},
+    {Opcode::XORI,  Format::I, MajorOpcode::OP_IMM, 4, 0},
+    {Opcode::ORI,   Format::I, MajorOpcode::OP_IMM, 6, 0},
+    {Opcode::ANDI,  Format::I, MajorOpcode::OP_IMM, 7, 0},
+    {Opcode::SLLI,  Format::I, MajorOpcode::OP_IMM, 1, 0x00},
+    {Opcode::SRLI,  Format::I, MajorOpcode::OP_IMM, 5, 0x00},
+    {Opcode::SRAI,  Format::I, MajorOpcode::OP_IMM, 5, 0x20},
+
+    {Opcode::ADD, Format::R, MajorOpcode::OP, 0, 0x00},
+    {Opcode::SUB, Format::R, MajorOpcode::OP, 0, 0x20},
+    {Opcode::SLL, Format::R, MajorOpcode::OP, 1, 0x00},
+    {Opcode::XOR, Format::R, MajorOpcode::OP, 4, 0x00},
+    {Opcode::SRL, Format::R, MajorOpcode::OP, 5, 0x00},
+    {Opcode::SRA, Format::R, MajorOpcode::OP, 5, 0x20},
+    {Opcode::OR,  Format::R, MajorOpcode::OP, 6, 0x00},
+    {Opcode::AND, Format::R, MajorOpcode::OP, 7, 0x00},
+    {Opcode::SLT, Format::R, MajorOpcode::OP, 2, 0x00},
+    {Opcode::SLTU, Format::R, MajorOpcode::OP, 3, 0x00},
+    {Opcode::MUL, Format::R, MajorOpcode::OP, 0, 0x01},
+
+    {Opcode::FENCE, Format::I, MajorOpcode::MISC_MEM, 0, 0},
+    {Opcode::ECALL, Format::I, MajorOpcode::SYSTEM,   0, 0}, // EBREAK differs only in the immediate
+    {Opcode::RDCYCLE, Format::I, MajorOpcode::SYSTEM, 2, 0}, // CSRRS; the counter is picked by the CSR number
+};
+
+// The counter reads and the CSR each one encodes
+const struct {
+    Opcode opcode;
+    uint32_t csr;
+} counterReads[] = {
+    {Opcode::RDCYCLE,   CounterCSR::CYCLE},   {Opcode::RDCYCLEH,   CounterCSR::CYCLEH},
+    {Opcode::RDTIME,    CounterCSR::TIME},    {Opcode::RDTIMEH,    CounterCSR::TIMEH},
+    {Opcode::RDINSTRET, CounterCSR::INSTRET}, {Opcode::RDINSTRETH, CounterCSR::INSTRETH},
+};
+
+// Only reads (rs1 = x0) of the counter CSRs are supported
+Opcode counterReadOf(uint32_t csr, uint32_t rs1) {
+    if (rs1 != 0) return Opcode::INVALID;
+    for (const auto& counter : counterReads)
+        if (counter.csr == csr) return counter.opcode;
+    return Opcode::INVALID;
+}
+
+bool isShiftImmediate(Opcode op) {
+    return op == Opcode::SLLI || op == Opcode::SRLI || op == Opcode::SRAI;
+}
+
+const EncodingInfo& encodingOf(Opcode op) {
+    for (const auto& info : encodings)
+        if (info.opcode == op) return info;
+    throw std::runtime_error("Opcode has no encoding");
+}
+
+// Decode table key: major opcode, funct3, and the two funct7 bits that tell
+// opcodes apart (bit 30: SUB/SRA/SRAI, bit 25: MUL)
+uint32_t decodeKey(uint32_t word) {
+    return (word & 0x7F) | ((word >> 12) & 0x7) << 7 | ((word >> 30) & 0x1) << 10 | ((word >> 25) & 0x1) << 11;
+}
+
+struct DecodeTable {
+    std::array<Opcode, 4096> opcode;
+    std::array<Format, 128> format;
+
+    DecodeTable() {
+        opcode.fill(Opcode::INVALID);
+        format.fill(Format::R);
+        for (const auto& info : encodings) {
+            format[info.major] = info.format;
+            bool anyFunct3 = info.format == Format::U || info.format == Format::J;
+            bool fixedFunct7 = info.format == Format::R || isShiftImmediate(info.opcode);
+            for (uint32_t key = 0; key < opcode.size(); ++key) {
+                if ((key & 0x7F) != info.major) continue;
+                if (!anyFunct3 && ((key >> 7) & 0x7) != info.funct3) continue;
+                if (fixedFunct7 && (((key >> 10) & 1) != ((info.funct7 >> 5) & 1) || ((key >> 11) & 1) != (info.funct7 & 1))) continue;
+                opcode[key] = info.opcode;
+            }
+        }
+    }
+};
+
+const DecodeTable decodeTable;
+
+// Field extraction
+inline uint32_t bits(uint32_t word, int hi, int lo) { return (word >> lo) & ((1u << (hi - lo + 1)) - 1); }
+inline int32_t signExtend(uint32_t value, int width) {
+    uint32_t m = 1u << (width - 1);
+    return static_cast<int32_t>((value ^ m) - m);
+}
+
+int32_t immediateOf(uint32_t word, Format format) {
+    switch (format) {
+        case Format::I: return static_cast<int32_t>(word) >> 20;
+        case Format::S: return signExtend(bits(word, 31, 25) << 5 | bits(word, 11, 7), 12);
+        case Format::B: return signExtend(bits(word, 31, 31) << 12 | bits(word, 7, 7) << 11 |
+                                          bits(word, 30, 25) << 5 | bits(word, 11, 8) << 1, 13);
+        case Format::U: return static_cast<int32_t>(word & 0xFFFFF000);
+        case Format::J: return signExtend(bits(word, 31, 31) << 20 | bits(word, 19, 12) << 12 |
+                                          bits(word, 20, 20) << 11 | bits(word, 30, 21) << 1, 21);
+        default: return 0;
+    }
+}
+
+// Field packing
+uint32_t encodeR(uint32_t f7, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op) {
+    return f7 << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+uint32_t encodeI(int32_t imm, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op) {
+    return (static_cast<uint32_t>(imm) & 0xFFF) << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+uint32_t encodeS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t op) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return bits(u, 11, 5) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | bits(u, 4, 0) << 7 | op;
+}
+uint32_t encodeB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t op) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return bits(u, 12, 12) << 31 | bits(u, 10, 5) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 |
+           bits(u, 4, 1) << 8 | bits(u, 11, 11) << 7 | op;
+}
+uint32_t encodeU(int32_t imm, uint32_t rd, uint32_t op) {
+    return (static_cast<uint32_t>(imm) & 0xFFFFF) << 12 | rd << 7 | op;
+}
+uint32_t encodeJ(int32_t imm, uint32_t rd, uint32_t op) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return bits(u, 20, 20) << 31 | bits(u, 10, 1) << 21 | bits(u, 11, 11) << 20 | bits(u, 19, 12) << 12 | rd << 7 | op;
+}
+
+// Register number of "xN", throws if it is not one of x0..x31
+uint32_t reg(const std::string& name, const Instruction& inst) {
+    bool ok = name.size() > 1 && name.size() <= 3 && name[0] == 'x' &&
+              std::all_of(name.begin() + 1, name.end(), ::isdigit);
+    if (ok) {
+        int n = std::stoi(name.substr(1));
+        if (n < 32) return static_cast<uint32_t>(n);
+    }
+    throw std::runtime_error("Invalid register '" + name + "' in instruction: " + inst.toString());
+}
+
+// Branch/jump offsets are given in lines and encoded as byte offsets, 4 bytes
+// per line as in RV32I. The 13-bit B-type field therefore holds -1024..1023
+// lines (the text dialect accepted -2048..2047 before programs were stored as
+// machine words) and the 21-bit J-type field -262144..262143 lines.
+int32_t byteOffset(int64_t lines, int width, const Instruction& inst) {
+    int64_t limit = int64_t(1) << (width - 3); // in lines
+    if (lines < -limit || lines >= limit) {
+        const char* kind = width == 13 ? "Branch" : "Jump";
+        throw std::runtime_error(std::string(kind) + " offset " + std::to_string(lines) + " is outside the "
+                                 + std::to_string(-limit) + ".." + std::to_string(limit - 1)
+                                 + " line range in instruction: " + inst.toString());
+    }
+    return static_cast<int32_t>(lines * 4);
+}
+
+} // namespace
+
+uint32_t assemble(const Instruction& inst, std::vector<std::string>& symbols) {
+    const Operands& ops = inst.getOperands();
+    switch (inst.getOpcode()) {
+        case Opcode::NOP:
+            return END_WORD;
+        case Opcode::INVALID:
+            return 0; // all-zero word is an illegal instruction, it fails when executed
+        case Opcode::ECALL:
+            return encodeI(0, 0, 0, 0, MajorOpcode::SYSTEM);
+        case Opcode::EBREAK:
+            return encodeI(1, 0, 0, 0, MajorOpcode::SYSTEM);
+        case Opcode::LI: // ADDI rd, x0, imm
+            return encodeI(ops.immediate, 0, 0, reg(ops.rd, inst), MajorOpcode::OP_IMM);
+        case Opcode::LA: {
+            auto it = std::find(symbols.begin(), symbols.end(), ops.var);
+            uint32_t index = static_cast<uint32_t>(it - symbols.begin());
+            if (it == symbols.end()) symbols.push_back(ops.var);
+            if (index > 0xFFFFF) throw std::runtime_error("Too many variables referenced by LA");
+            return index << 12 | reg(ops.rd, inst) << 7 | MajorOpcode::CUSTOM0;
+        }
+        default:
+            break;
+    }
+    for (const auto& counter : counterReads)
+        if (counter.opcode == inst.getOpcode())
+            return encodeI(counter.csr, 0, 2, reg(ops.rd, inst), MajorOpcode::SYSTEM);
+
+    const EncodingInfo& info = encodingOf(inst.getOpcode());
+    switch (info.format) {
+        case Format::R:
+            return encodeR(info.funct7, reg(ops.rs2, inst), reg(ops.rs1, inst), info.funct3, reg(ops.rd, inst), info.major);
+        case Format::I: {
+            int32_t imm = ops.immediate;
+            if (isShiftImmediate(info.opcode)) {
+                if (imm < 0 || imm > 31) throw std::runtime_error("Shift amount out of range in instruction: " + inst.toString());
+                imm |= info.funct7 << 5;
+            }
+            return encodeI(imm, reg(ops.rs1, inst), info.funct3, reg(ops.rd, inst), info.major);
+        }
+        case Format::S: // the value register is parsed into rd
+            return encodeS(ops.immediate, reg(ops.rd, inst), reg(ops.rs1, inst), info.funct3, info.major);
+        case Format::B: // the two compared registers are parsed into rd and rs1
+            return encodeB(byteOffset(ops.immediate, 13, inst), reg(ops.rs1, inst), reg(ops.rd, inst), info.funct3, info.major);
+        case Format::U:
+            return encodeU(ops.immediate, reg(ops.rd, inst), info.major);
+        case Format::J:
+            return encodeJ(byteOffset(ops.immediate, 21, inst), reg(ops.rd, inst), info.major);
+    }
+    return 0;
+}
+
+DecodedInstruction decode(uint32_t word) {
+    DecodedInstruction d;
+    d.opcode = decodeTable.opcode[decodeKey(word)];
+    Format format = decodeTable.format[word & 0x7F];
+    d.rd  = (format == Format::S || format == Format::B) ? 0 : bits(word, 11, 7);
+    d.rs1 = (format == Format::U || format == Format::J) ? 0 : bits(word, 19, 15);
+    d.rs2 = (format == Format::R || format == Format::S || format == Format::B) ? bits(word, 24, 20) : 0;
+    d.imm = immediateOf(word, format);
+    if (format == Format::B || format == Format::J) d.imm >>= 2; // bytes to instructions
+    if (d.opcode == Opcode::LA) d.imm = static_cast<int32_t>(word >> 12);
+    else if (d.opcode == Opcode::ECALL && d.imm == 1) d.opcode = Opcode::EBREAK;
+    else if (d.opcode == Opcode::RDCYCLE) d.opcode = counterReadOf(d.imm & 0xFFF, d.rs1);
+    else if (isShiftImmediate(d.opcode)) d.imm &= 0x1F;
+    return d;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+
+// RV32I instruction formats
+enum class Format : uint8_t { R, I, S, B, U, J };
+
+// Major opcodes (bits 6..0 of an instruction word)
+namespace MajorOpcode {
+    const uint32_t LOAD     = 0x03;
+    const uint32_t CUSTOM0  = 0x0B; // LA pseudo instruction: rd, symbol index in bits 31..12
+    const uint32_t MISC_MEM = 0x0F;
+    const uint32_t CUSTOM1  = 0x2B; // NOP of the text dialect: end of program
+    const uint32_t OP_IMM   = 0x13;
+    const uint32_t AUIPC    = 0x17;
+    const uint32_t STORE    = 0x23;
+    const uint32_t OP       = 0x33;
+    const uint32_t LUI      = 0x37;
+    const uint32_t BRANCH   = 0x63;
+    const uint32_t JALR     = 0x67;
+    const uint32_t JAL      = 0x6F;
+    const uint32_t SYSTEM   = 0x73;
+}
+
+// User-level counter CSRs, read with CSRRS rd, csr, x0 (RDCYCLE and friends)
+namespace CounterCSR {
+    const uint32_t CYCLE    = 0xC00;
+    const uint32_t TIME     = 0xC01;
+    const uint32_t INSTRET  = 0xC02;
+    const uint32_t CYCLEH   = 0xC80;
+    const uint32_t TIMEH    = 0xC81;
+    const uint32_t INSTRETH = 0xC82;
+}
+
+// A text NOP ends the program. It has its own word rather than the RV32I NOP
+// (ADDI x0, x0, 0), so that a real ADDI x0, x0, 0 line still fails as a write to x0.
+const uint32_t END_WORD = MajorOpcode::CUSTOM1;
+
+// An instruction word with its fields extracted.
+// Fields a format does not have are 0. Branch and jump offsets are in
+// instructions (the encoded byte offset / 4) since the PC indexes the program.
+struct DecodedInstruction {
+    Opcode opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;
+};
+static_assert(sizeof(DecodedInstruction) == 8, "the predecoded program is meant to stay dense");
+
+// True for the decoded form of END_WORD
+inline bool isNop(const DecodedInstruction& d) {
+    return d.opcode == Opcode::NOP;
+}
+
+// Encode a parsed text instruction into a 32-bit RV32I word.
+// LA has no RV32I equivalent; its variable name is interned in symbols and
+// the word carries the index. Throws on operands that cannot be encoded.
+uint32_t assemble(const Instruction& inst, std::vector<std::string>& symbols);
+
+// Decode an instruction word; unknown encodings decode to Opcode::INVALID
+DecodedInstruction decode(uint32_t word);
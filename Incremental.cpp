@@ -0,0 +1,146 @@
+#include "Incremental.h"
+#include <algorithm>
+
+IncrementalSession::IncrementalSession(CPU& cpu, std::ostream& out, uint64_t interval, size_t maxUndo)
+    : cpu_(cpu), memory_(*cpu.getMemory()), out_(out), interval_(interval), maxUndo_(maxUndo) {
+    cpu_.getConsole().setOutput(capture_);
+    cpu_.attachSession(this);
+}
+
+IncrementalSession::~IncrementalSession() {
+    cpu_.attachSession(nullptr);
+    cpu_.getConsole().setOutput(out_);
+}
+
+uint64_t IncrementalSession::run(uint64_t budget) {
+    // Latest checkpoint the edit left intact and that is still within the budget
+    size_t resume = checkpoints_.size();
+    if (started_ && !dataChanged_) {
+        size_t changed = firstChange();
+        while (resume > 0) {
+            const Checkpoint& checkpoint = checkpoints_[resume - 1];
+            // A program that had already exited would not run lines appended after it
+            if (checkpoint.reached <= changed && !checkpoint.state.halted && (budget == 0 || checkpoint.instret < budget))
+                break;
+            --resume;
+        }
+    } else {
+        resume = 0;
+    }
+    if (resume > 0) rollBack(resume - 1);
+    else startOver();
+    rememberProgram();
+    started_ = true;
+    dataChanged_ = false;
+
+    uint64_t skipped = cpu_.getInstret();
+    cpu_.setInstructionBudget(budget ? budget - skipped : 0);
+    try {
+        cpu_.run();
+    } catch (...) {
+        cpu_.setInstructionBudget(budget);
+        finishOutput();
+        throw;
+    }
+    cpu_.setInstructionBudget(budget);
+    finishOutput();
+    return skipped;
+}
+
+void IncrementalSession::logStore(uint32_t address, uint32_t width) {
+    if (width == 4) {
+        saveWord(address);
+    } else {
+        // Byte and half stores rewrite the aligned word(s) holding them
+        uint32_t first = address & ~3u, last = (address + width - 1) & ~3u;
+        saveWord(first);
+        if (last != first) saveWord(last);
+    }
+    if (undo_.size() > maxUndo_) trim();
+}
+
+void IncrementalSession::saveWord(uint32_t address) {
+    Undo entry{address, false, 0};
+    entry.hadValue = memory_.tryLoad(address, entry.value);
+    undo_.push_back(entry);
+}
+
+void IncrementalSession::addCheckpoint() {
+    uint64_t instret = cpu_.getInstret();
+    checkpoints_.push_back({cpu_.saveState(), instret, reached_, undoBase_ + undo_.size(),
+                            cpu_.getConsole().bytesWritten() - consoleBase_});
+    lastCheckpoint_ = instret;
+    if (checkpoints_.size() > MAX_CHECKPOINTS) trim();
+}
+
+// Drop the oldest checkpoints until the log and the checkpoint list are at half
+// their limits, so trimming is not repeated on every store
+void IncrementalSession::trim() {
+    while (!checkpoints_.empty() && (undo_.size() > maxUndo_ / 2 || checkpoints_.size() > MAX_CHECKPOINTS / 2)) {
+        checkpoints_.pop_front();
+        uint64_t keep = checkpoints_.empty() ? undoBase_ + undo_.size() : checkpoints_.front().undoPosition;
+        undo_.erase(undo_.begin(), undo_.begin() + (keep - undoBase_));
+        undoBase_ = keep;
+    }
+}
+
+size_t IncrementalSession::firstChange() const {
+    size_t count = std::min(lastProgram_.size(), memory_.instructionCount());
+    for (size_t pc = 0; pc < count; ++pc) {
+        if (memory_.fetchInstruction(pc) != lastProgram_[pc]) return pc;
+        // Equal LA words may name different variables: the word holds an index into the name table
+        const DecodedInstruction& inst = memory_.fetchDecoded(pc);
+        if (inst.opcode == Opcode::LA && memory_.getSymbolRef(inst.imm) != lastSymbols_[pc]) return pc;
+    }
+    return count;
+}
+
+void IncrementalSession::rememberProgram() {
+    size_t count = memory_.instructionCount();
+    lastProgram_.resize(count);
+    lastSymbols_.assign(count, std::string());
+    for (size_t pc = 0; pc < count; ++pc) {
+        lastProgram_[pc] = memory_.fetchInstruction(pc);
+        const DecodedInstruction& inst = memory_.fetchDecoded(pc);
+        if (inst.opcode == Opcode::LA) lastSymbols_[pc] = memory_.getSymbolRef(inst.imm);
+    }
+}
+
+void IncrementalSession::startOver() {
+    // The data as loaded is kept aside at the first run after loading it
+    if (started_ && !dataChanged_) memory_.restoreData();
+    else memory_.snapshotData();
+    cpu_.reset();
+    undo_.clear();
+    undoBase_ = 0;
+    checkpoints_.clear();
+    reached_ = 0;
+    lastCheckpoint_ = 0;
+    output_.clear();
+    consoleBase_ = cpu_.getConsole().bytesWritten();
+}
+
+void IncrementalSession::rollBack(size_t index) {
+    const Checkpoint& checkpoint = checkpoints_[index];
+    size_t keep = checkpoint.undoPosition - undoBase_;
+    for (size_t i = undo_.size(); i-- > keep;) {
+        const Undo& entry = undo_[i];
+        if (entry.hadValue) memory_.store(entry.address, entry.value);
+        else memory_.forget(entry.address);
+    }
+    undo_.resize(keep);
+    cpu_.restoreState(checkpoint.state);
+    reached_ = checkpoint.reached;
+    lastCheckpoint_ = checkpoint.instret;
+    output_.resize(checkpoint.consoleOffset);
+    consoleBase_ = cpu_.getConsole().bytesWritten() - checkpoint.consoleOffset;
+    checkpoints_.resize(index + 1); // the rest belong to the old program's tail
+}
+
+void IncrementalSession::finishOutput() {
+    cpu_.getConsole().flush();
+    output_ += capture_.str();
+    capture_.str({});
+    out_ << output_;
+    out_.flush();
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+// Re-runs of an edited program that skip what the edit cannot have changed.
+// While the program runs, every store appends the word it overwrites to an
+// undo log, and at taken branches (basic-block boundaries) the session takes
+// a checkpoint: the CPU state, the position in the undo log, the console
+// output so far and the highest line executed so far. One is taken whenever
+// execution reaches a new highest line, otherwise every `interval` instructions.
+// Execution up to a checkpoint only depended on the lines up to its highest
+// line, so a program whose first changed line lies beyond it reaches exactly
+// the same state. run() rolls memory back to the latest such checkpoint by
+// undoing the later stores, restores the CPU state and continues from there;
+// the output printed before the checkpoint is kept and printed again, so each
+// run prints and leaves in memory what a full rerun would. A checkpoint taken
+// after the program exited is never resumed from: lines appended after the
+// exit would run there, but not in a full rerun.
+// The undo log and the checkpoints are bounded: when either is full the
+// oldest checkpoints are dropped, along with the log entries before the
+// oldest remaining one (rolling back never goes further than that).
+// Reloading the data invalidates the checkpoints and the next run starts over.
+class IncrementalSession {
+public:
+    // Program output is captured to be replayed and written to out after each run
+    IncrementalSession(CPU& cpu, std::ostream& out, uint64_t interval = 1 << 16, size_t maxUndo = 1 << 22);
+    ~IncrementalSession();
+    IncrementalSession(const IncrementalSession&) = delete;
+    IncrementalSession& operator=(const IncrementalSession&) = delete;
+
+    // The data memory was reloaded: the next run starts from the beginning
+    void dataChanged() { dataChanged_ = true; }
+
+    // Run the loaded program to the end, or until budget instructions (0 = no
+    // limit) have retired counting the skipped prefix. Returns the number of
+    // instructions skipped by resuming from a checkpoint.
+    uint64_t run(uint64_t budget = 0);
+
+    // Hooks of the CPU (checked and trace engines)
+    void recordStore(uint32_t address, uint32_t width) {
+        if (!checkpoints_.empty()) logStore(address, width);
+    }
+    void blockBoundary(uint32_t branchPC) {
+        // A straight-line block ends at its branch, so that is its highest line
+        bool newLine = branchPC >= reached_;
+        if (newLine) reached_ = branchPC + 1;
+        if (newLine || cpu_.getInstret() - lastCheckpoint_ >= interval_) addCheckpoint();
+    }
+
+private:
+    static const size_t MAX_CHECKPOINTS = 1 << 16;
+
+    struct Undo {
+        uint32_t address;
+        bool hadValue; // false: the store created the word, undo erases it
+        int32_t value;
+    };
+
+    struct Checkpoint {
+        CPU::State state;
+        uint64_t instret;
+        uint32_t reached;       // lines [0, reached) may have executed before it
+        uint64_t undoPosition;  // absolute index into the undo log
+        uint64_t consoleOffset; // bytes printed before it
+    };
+
+    void logStore(uint32_t address, uint32_t width);
+    void saveWord(uint32_t address);
+    void addCheckpoint();
+    void trim();
+    // First line where the loaded program differs from the one last run
+    size_t firstChange() const;
+    void rememberProgram();
+    void startOver();
+    void rollBack(size_t checkpoint);
+    void finishOutput();
+
+    CPU& cpu_;
+    Memory& memory_;
+    std::ostream& out_;
+    uint64_t interval_;
+    size_t maxUndo_;
+    std::ostringstream capture_; // console output of the current run
+    std::string output_; // everything the current execution printed, prefix included
+    uint64_t consoleBase_ = 0; // console bytesWritten() at the start of the execution
+
+    std::deque<Undo> undo_;
+    uint64_t undoBase_ = 0; // absolute index of undo_.front()
+    std::deque<Checkpoint> checkpoints_;
+    uint32_t reached_ = 0;
+    uint64_t lastCheckpoint_ = 0; // instret at the last checkpoint
+
+    std::vector<uint32_t> lastProgram_; // the program of the last run, word by word
+    std::vector<std::string> lastSymbols_; // variable named by each LA of it
+    bool started_ = false;
+    bool dataChanged_ = false;
+};
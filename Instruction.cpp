@@ -11,11 +11,15 @@ static const std::unordered_map<std::string, Opcode> table = {
     {"LUI", Opcode::LUI}, {"AUIPC", Opcode::AUIPC}, {"JAL", Opcode::JAL}, {"JALR", Opcode::JALR},
     {"LA", Opcode::LA},
     {"ADD", Opcode::ADD}, {"SUB", Opcode::SUB}, {"AND", Opcode::AND}, {"OR", Opcode::OR},
-    {"XOR", Opcode::XOR}, {"SLL", Opcode::SLL}, {"SRL", Opcode::SRL}, {"SRA", Opcode::SRA}, {"ADDI", Opcode::ADDI},
+    {"XOR", Opcode::XOR}, {"MUL", Opcode::MUL}, {"SLL", Opcode::SLL}, {"SRL", Opcode::SRL}, {"SRA", Opcode::SRA},
+    {"SLT", Opcode::SLT}, {"SLTU", Opcode::SLTU}, {"ADDI", Opcode::ADDI},
     {"SLTI", Opcode::SLTI}, {"SLTIU", Opcode::SLTIU}, {"XORI", Opcode::XORI}, {"ORI", Opcode::ORI},
     {"ANDI", Opcode::ANDI}, {"SLLI", Opcode::SLLI}, {"SRLI", Opcode::SRLI}, {"SRAI", Opcode::SRAI},
     {"BEQ", Opcode::BEQ}, {"BNE", Opcode::BNE}, {"BLT", Opcode::BLT}, {"BGE", Opcode::BGE},
     {"BLTU", Opcode::BLTU}, {"BGEU", Opcode::BGEU},
+    {"ECALL", Opcode::ECALL}, {"EBREAK", Opcode::EBREAK},
+    {"RDCYCLE", Opcode::RDCYCLE}, {"RDCYCLEH", Opcode::RDCYCLEH}, {"RDTIME", Opcode::RDTIME},
+    {"RDTIMEH", Opcode::RDTIMEH}, {"RDINSTRET", Opcode::RDINSTRET}, {"RDINSTRETH", Opcode::RDINSTRETH},
     {"INVALID", Opcode::INVALID}
 
 };
@@ -26,6 +30,24 @@ Opcode Instruction::stringToOpcode(const std::string& s) {
     return it != table.end() ? it->second : Opcode::INVALID;
 }
 
+static const char* const names[] = {
+    "NOP",
+    "SW", "SH", "SB", "LH", "LB", "LHU", "LBU", "LW", "LI",
+    "LUI", "AUIPC", "JAL", "JALR", "LA",
+    "ADD", "SUB", "AND", "OR", "XOR", "MUL",
+    "SLL", "SRL", "SRA", "SLT", "SLTU",
+    "ADDI", "SLTI", "SLTIU", "XORI", "ORI", "ANDI", "SLLI", "SRLI", "SRAI",
+    "BEQ", "BNE", "BLT", "BGE", "BLTU", "BGEU",
+    "FENCE", "ECALL", "EBREAK",
+    "RDCYCLE", "RDCYCLEH", "RDTIME", "RDTIMEH", "RDINSTRET", "RDINSTRETH",
+    "INVALID"
+};
+static_assert(sizeof(names) / sizeof(names[0]) == size_t(Opcode::INVALID) + 1, "one name per opcode");
+
+const char* Instruction::opcodeToString(Opcode opcode) {
+    return names[static_cast<size_t>(opcode)];
+}
+
 // Constructor that parses a line of instruction and initializes the opcode and operands
 Instruction::Instruction(const std::string& line) : originalLine(line), valid(false) {
     std::istringstream iss(line);
@@ -43,7 +65,8 @@ Instruction::Instruction(const std::string& line) : originalLine(line), valid(fa
             valid = operands.valid;
         }
     else if(opcode == Opcode::ADD || opcode == Opcode::SUB || opcode == Opcode::AND || opcode == Opcode::OR || opcode == Opcode::XOR
-            || opcode == Opcode::SLL || opcode == Opcode::SRL || opcode == Opcode::SRA || opcode == Opcode::MUL) {
+            || opcode == Opcode::SLL || opcode == Opcode::SRL || opcode == Opcode::SRA || opcode == Opcode::MUL
+            || opcode == Opcode::SLT || opcode == Opcode::SLTU) {
                 operands = parseThreeReg(operandsPart);
                 valid = operands.valid;
             }
@@ -60,8 +83,13 @@ Instruction::Instruction(const std::string& line) : originalLine(line), valid(fa
                 operands = parseLoadAddress(operandsPart);
                 valid = operands.valid;
     }
-    else if(opcode == Opcode::NOP) {
-        valid = true; // NOP is always valid
+    else if(opcode == Opcode::RDCYCLE || opcode == Opcode::RDCYCLEH || opcode == Opcode::RDTIME
+            || opcode == Opcode::RDTIMEH || opcode == Opcode::RDINSTRET || opcode == Opcode::RDINSTRETH) {
+                operands = parseOneReg(operandsPart);
+                valid = operands.valid;
+    }
+    else if(opcode == Opcode::NOP || opcode == Opcode::ECALL || opcode == Opcode::EBREAK) {
+        valid = true; // no operands, always valid
     }
     if(!valid) {
         throw std::runtime_error("Invalid operands in instruction: " + line);
@@ -140,6 +168,15 @@ Operands Instruction::parseLoadAddress(const std::string& operandPart) {
     return result;
 }
 
+// Parses a single register like "x5"
+Operands Instruction::parseOneReg(const std::string& operandPart) {
+    Operands result;
+    result.rd = trim(operandPart);
+    result.immediate = 0;
+    result.valid = !result.rd.empty();
+    return result;
+}
+
 // Parses a line like "x1, x2, x3" or "x10,x11,x12"
 Operands Instruction::parseThreeReg(const std::string& operandPart) {
     Operands result;
@@ -1,15 +1,18 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 
-enum class Opcode {
+enum class Opcode : uint8_t {
     NOP,
     SW, SH, SB, LH, LB, LHU, LBU, LW, LI, 
     LUI, AUIPC, JAL, JALR, LA,
     ADD, SUB, AND, OR, XOR, MUL,
-    SLL, SRL, SRA,
+    SLL, SRL, SRA, SLT, SLTU,
     ADDI, SLTI, SLTIU, XORI, ORI, ANDI, SLLI, SRLI, SRAI,
     BEQ, BNE, BLT, BGE, BLTU, BGEU,
+    FENCE, ECALL, EBREAK,
+    RDCYCLE, RDCYCLEH, RDTIME, RDTIMEH, RDINSTRET, RDINSTRETH,
     INVALID
 };
 
@@ -38,6 +41,7 @@ private:
     Operands parseRegImm(const std::string& operandPart);
     Operands parseStoreLoad(const std::string& operandPart);
     Operands parseLoadAddress(const std::string& operandPart);
+    Operands parseOneReg(const std::string& operandPart);
 public:
     // constructor which decodes the instruction from a line of text
     Instruction(const std::string& line);  
@@ -52,6 +56,8 @@ public:
 
     // used for decoding the opcode from a string
     static Opcode stringToOpcode(const std::string&);
+    // Mnemonic of an opcode, for reports
+    static const char* opcodeToString(Opcode opcode);
 
 friend class CPU;
 };
@@ -0,0 +1,51 @@
+#include "Machine.h"
+
+Machine::Machine() {
+    cpu_.getConsole().setOutput(console_);
+    cpu_.setDiagnosticOutput(diagnostics_);
+}
+
+void Machine::loadProgram(std::string_view source) {
+    memory().loadInstructions(source);
+    cpu_.reset();
+}
+
+void Machine::loadData(std::string_view data) {
+    memory().clear();
+    std::istringstream in{std::string(data)};
+    memory().loadVariables(in);
+    memory().snapshotData();
+}
+
+bool Machine::run(uint64_t budget) {
+    cpu_.setInstructionBudget(budget);
+    cpu_.run(); // flushes the console into console_, also when it throws
+    return !cpu_.budgetExhausted();
+}
+
+void Machine::reset() {
+    cpu_.reset();
+    memory().restoreData();
+    cpu_.getConsole().flush();
+    console_.str({});
+    diagnostics_.str({});
+}
+
+std::string Machine::dumpData() const {
+    std::ostringstream out;
+    memory().saveData(out);
+    return out.str();
+}
+
+std::string Machine::takeConsoleOutput() {
+    cpu_.getConsole().flush();
+    std::string text = console_.str();
+    console_.str({});
+    return text;
+}
+
+std::string Machine::takeDiagnosticOutput() {
+    std::string text = diagnostics_.str();
+    diagnostics_.str({});
+    return text;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include "CPU.h"
+
+// Embeddable interpreter: a CPU with its memory behind an API that takes the
+// program and data as text buffers and never reads or writes the process's
+// standard streams. Program output is collected in the machine (see
+// takeConsoleOutput) and errors are thrown as exceptions.
+//
+// A machine can be reused for any number of runs: reset() puts back the
+// registers and the data loaded by loadData() in place, and loading a new
+// program reuses the storage of the previous one, so a caller running many
+// inputs through one machine does not allocate per run once it is warm.
+// Machines share no state, so separate machines may run on separate threads.
+class Machine {
+public:
+    Machine();
+    Machine(const Machine&) = delete;
+    Machine& operator=(const Machine&) = delete;
+
+    // Assemble a text program, one instruction per line, replacing the current
+    // one, and reset the registers. Throws on the first invalid line.
+    void loadProgram(std::string_view source);
+
+    // Replace data memory with "name address [value]" lines; this becomes the
+    // data reset() restores
+    void loadData(std::string_view data);
+
+    // Continue from the current state for at most budget instructions
+    // (0 = no limit). Returns true if the program finished, false if it
+    // stopped at the budget and can be resumed by another run().
+    bool run(uint64_t budget = 0);
+
+    // Registers, PC, counters and data memory back to how loadData() left them
+    void reset();
+
+    // Engine of later runs (CHECKED by default; TRACE writes to the diagnostic output)
+    void setEngine(Engine engine) { cpu_.setEngine(engine); }
+
+    int32_t getRegister(size_t idx) const { return cpu_.getRegister(idx); }
+    void setRegister(size_t idx, int32_t value) { cpu_.setRegister(idx, value); }
+    uint32_t getPC() const { return cpu_.getPC(); }
+    uint64_t getInstret() const { return cpu_.getInstret(); }
+    int32_t getExitCode() const { return cpu_.getExitCode(); }
+
+    // Data memory by word address or variable name
+    int32_t readWord(uint32_t address) const { return memory().load(address); }
+    void writeWord(uint32_t address, int32_t value) { memory().store(address, value); }
+    uint32_t addressOf(const std::string& name) const { return memory().getVariableAddress(name); }
+
+    // The named variables in the "name address value" format of output.txt
+    std::string dumpData() const;
+
+    // Text printed by the program (print ECALLs, write to fd 1) since the last
+    // call; the stderr writes and the trace are kept apart in the diagnostics
+    std::string takeConsoleOutput();
+    std::string takeDiagnosticOutput();
+
+    CPU& getCPU() { return cpu_; }
+
+private:
+    Memory& memory() const { return *cpu_.getMemory(); }
+
+    // Declared before cpu_: its console flushes into console_ when destroyed
+    std::ostringstream console_;
+    std::ostringstream diagnostics_;
+    CPU cpu_;
+};
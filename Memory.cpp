@@ -1,8 +1,17 @@
 #include "Memory.h"
-#include <iostream>
+#include "Encoding.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 Memory::Memory(std::string& codeFile, std::string& dataFile) {
     // Load instructions from file
     loadInstructionsUsingFile(codeFile);
@@ -11,38 +20,39 @@ Memory::Memory(std::string& codeFile, std::string& dataFile) {
     loadVariablesFromFile(dataFile);
 }
 
-// insert instructions manually, for interactive mode
-void Memory::insertInstructionsManually(std::string& codeFile) {
-    // std::cout << "Enter instructions (one per line, empty line to finish):\n";
-    // remove the above comment in case of interactive mode
-    program_.clear(); // Clear existing instructions
-    codeFile = "new_instructions.txt"; 
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        if (line.empty()) break; // Stop on empty line
-        program_.emplace_back(line);
-    }
+Memory::~Memory() {
+    for (const Region& region : regions_) munmap(region.host, region.mappedLength);
 }
 
-// load instructions from a file specified by the user
-void Memory::loadInstructionsFromFile(std::string& codeFile) {
-    program_.clear(); // Clear existing instructions
-    // std::cout << "Enter the instruction file name: ";
-    // remove the above comment in case of interactive mode
-    std::string filename;
-    std::cin >> filename;
-    codeFile = filename; 
-    loadInstructionsUsingFile(filename);
+// Replace the program with the instructions in text, one per line
+void Memory::loadInstructions(std::string_view text) {
+    clearProgram();
+    reserveProgram(std::count(text.begin(), text.end(), '\n') + 1, text.size());
+    std::string line;
+    while (!text.empty()) {
+        size_t end = std::min(text.find('\n'), text.size());
+        line.assign(text.substr(0, end));
+        text.remove_prefix(std::min(end + 1, text.size()));
+        if (line.empty()) continue; // Skip empty lines
+        appendInstruction(line);
+    }
 }
 
 //load instructions from an existing file
-void Memory::loadInstructionsUsingFile(std::string& filename) {
-    std::ifstream code(filename);
+void Memory::loadInstructionsUsingFile(const std::string& filename) {
+    std::ifstream code(filename, std::ios::binary);
     if (!code) throw std::runtime_error("Failed to open instruction file.");
+    clearProgram();
+    // Count the lines first so the program arrays are allocated once
+    size_t lines = std::count(std::istreambuf_iterator<char>(code), std::istreambuf_iterator<char>(), '\n') + 1;
+    size_t bytes = static_cast<size_t>(code.tellg());
+    code.clear();
+    code.seekg(0);
+    reserveProgram(lines, bytes);
     std::string line;
     while (std::getline(code, line)) {
         if (line.empty()) continue; // Skip empty lines
-        program_.emplace_back(line); 
+        appendInstruction(line);
     }
     code.close();
     // Optionally, you can check if program_ is empty and throw an error
@@ -51,71 +61,105 @@ void Memory::loadInstructionsUsingFile(std::string& filename) {
     // }
 }
 
-// Load variables from a file specified by the user
-void Memory::loadVariablesFromFile(uint32_t& nextAddress, std::string& dataFile) {
-    clear(); // Clear existing variables
-    // std::cout << "Enter the data file name: "; 
-    // remove the above comment in case of interactive mode
-    std::string filename;
-    std::cin >> filename;
-    std::cin.ignore();
-    dataFile = filename; 
-    loadVariablesFromFile(filename);
-    uint32_t maxAddr = 0;
-    for (const auto& name : getVariableNames()) {
-        uint32_t addr = getVariableAddress(name);
-        if (addr > maxAddr) maxAddr = addr;
-    }
-    nextAddress = maxAddr + 4;
-}
-
 // Load variables from an existing file
 void Memory::loadVariablesFromFile(const std::string& dataFile) {
     std::ifstream in(dataFile);
     if(!in) throw std::runtime_error("Failed to open data file.");
+    loadVariables(in);
+}
+
+// Add the variables of "name address [value]" lines
+void Memory::loadVariables(std::istream& in) {
     std::string line;
     while (std::getline(in, line)) {
         std::istringstream ss(line);
         std::string var;
         uint32_t addr;
         int32_t val;
-        ss >> var >> addr >> val;
+        if (!(ss >> var >> addr)) continue;
         symbolTable_[var] = addr;
-        data_[addr] = val;
+        // "name address" only names a location, e.g. inside a data image
+        if (ss >> val) store(addr, val);
+        else if (!findRegion(addr, 4)) data_[addr] = 0;
     }
 }
 
-// Manual input of variables, for interactive mode
-void Memory::manualVariableInput(uint32_t& nextAddress, std::string& dataFile) {
-    clear(); // Clear existing variables
-    dataFile = "new_data.txt"; // Default output file name
-    while(true) {
-        //std::cout << "Enter variable name (or 'exit' to stop): ";
-        // remove the above comment in case of interactive mode
-        std::string varName;
-        std::cin >> varName;
-        if (varName == "exit") break;
+// Parse and encode one line of assembly
+void Memory::appendInstruction(const std::string& line) {
+    uint32_t word = assemble(Instruction(line), symbolRefs_);
+    program_.push_back(word);
+    decoded_.push_back(decode(word));
+    if (sourceOffsets_.empty()) sourceOffsets_.push_back(0);
+    sourceText_ += line;
+    sourceOffsets_.push_back(static_cast<uint32_t>(sourceText_.size()));
+}
 
-        // std::cout << "Enter variable value: ";
-        // remove the above comment in case of interactive mode
-        int32_t value;
-        std::cin >> value;
+void Memory::reserveProgram(size_t instructions, size_t sourceBytes) {
+    program_.reserve(instructions);
+    decoded_.reserve(instructions);
+    sourceOffsets_.reserve(instructions + 1);
+    sourceText_.reserve(sourceBytes);
+}
 
-        setVariable(varName, nextAddress);
-        store(nextAddress, value);
-        nextAddress += 4; // Assume word-aligned, 4-byte variables
-    }
+void Memory::clearProgram() {
+    program_.clear();
+    decoded_.clear();
+    sourceText_.clear();
+    sourceOffsets_.clear();
+    symbolRefs_.clear();
+    codeBase_ = 0;
+    codeShift_ = 0;
 }
 
-// Fetch an instruction by program counter (PC)
-const Instruction& Memory::fetchInstruction(uint32_t pc) const {
+// Replace the program with already encoded instruction words
+void Memory::loadBinaryProgram(const uint32_t* words, size_t count, uint32_t base) {
+    clearProgram();
+    program_.assign(words, words + count);
+    decoded_.reserve(count);
+    for (size_t i = 0; i < count; ++i) decoded_.push_back(decode(words[i]));
+    codeBase_ = base;
+    codeShift_ = 2;
+}
+
+// Fetch an instruction word by program counter (PC)
+uint32_t Memory::fetchInstruction(uint32_t pc) const {
     if (pc >= program_.size()) throw std::out_of_range("PC out of range");
     return program_[pc];
 }
 
+// Get the source text of the instruction at pc (empty for binary programs)
+std::string_view Memory::getSourceLine(uint32_t pc) const {
+    if (pc + 1 >= sourceOffsets_.size()) return {};
+    return std::string_view(sourceText_).substr(sourceOffsets_[pc], sourceOffsets_[pc + 1] - sourceOffsets_[pc]);
+}
+
+// Get the variable name an LA instruction refers to
+const std::string& Memory::getSymbolRef(uint32_t index) const {
+    if (index >= symbolRefs_.size()) throw std::out_of_range("Symbol reference out of range");
+    return symbolRefs_[index];
+}
+
 // Clear all data and symbol table 
 void Memory::clear() { data_.clear(); symbolTable_.clear(); }
 
+uint64_t Memory::dataFootprint() const {
+    // A node holds the next pointer and the key/value pair; malloc rounds it up to 32 bytes
+    uint64_t nodeBytes = std::max<uint64_t>(32, sizeof(void*) + sizeof(std::pair<const uint32_t, int32_t>));
+    return data_.size() * nodeBytes + data_.bucket_count() * sizeof(void*);
+}
+
+uint64_t Memory::mappedBytes() const {
+    uint64_t bytes = 0;
+    for (const Region& region : regions_) bytes += region.mappedLength;
+    return bytes;
+}
+
+// Keep a copy of the data memory for restoreData()
+void Memory::snapshotData() { initialData_ = data_; }
+
+// Copy assignment reuses data_'s nodes and buckets, so no allocation in the steady state
+void Memory::restoreData() { data_ = initialData_; }
+
 // Get the number of instructions in the program
 size_t Memory::instructionCount() const {
     return program_.size();
@@ -123,16 +167,154 @@ size_t Memory::instructionCount() const {
 
 // Store a value at a specific address
 void Memory::store(uint32_t address, int32_t value) {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 4)) {
+            std::memcpy(region->host + (address - region->base), &value, 4);
+            return;
+        }
+    }
     data_[address] = value;
 }
 
 // Load a value from a specific address
 int32_t Memory::load(uint32_t address) const {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 4)) {
+            int32_t value;
+            std::memcpy(&value, region->host + (address - region->base), 4);
+            return value;
+        }
+    }
     auto it = data_.find(address);
     if (it == data_.end()) throw std::runtime_error("Address not initialized");
     return it->second;
 }
 
+// Outside regions, bytes and halves are little-endian parts of the aligned word
+bool Memory::tryLoad(uint32_t address, int32_t& value) const {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 4)) {
+            std::memcpy(&value, region->host + (address - region->base), 4);
+            return true;
+        }
+    }
+    auto it = data_.find(address);
+    if (it == data_.end()) return false;
+    value = it->second;
+    return true;
+}
+
+void Memory::storeByte(uint32_t address, uint8_t value) {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 1)) {
+            region->host[address - region->base] = value;
+            return;
+        }
+    }
+    uint32_t shift = (address & 3) * 8;
+    int32_t& word = data_[address & ~3u];
+    word = static_cast<int32_t>((static_cast<uint32_t>(word) & ~(0xFFu << shift)) | (uint32_t(value) << shift));
+}
+
+void Memory::storeHalf(uint32_t address, uint16_t value) {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 2)) {
+            std::memcpy(region->host + (address - region->base), &value, 2);
+            return;
+        }
+    }
+    storeByte(address, value & 0xFF);
+    storeByte(address + 1, value >> 8);
+}
+
+uint32_t Memory::loadByte(uint32_t address) const {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 1)) return region->host[address - region->base];
+    }
+    return (static_cast<uint32_t>(load(address & ~3u)) >> ((address & 3) * 8)) & 0xFF;
+}
+
+uint32_t Memory::loadHalf(uint32_t address) const {
+    if (!regions_.empty()) {
+        if (const Region* region = findRegion(address, 2)) {
+            uint16_t value;
+            std::memcpy(&value, region->host + (address - region->base), 2);
+            return value;
+        }
+    }
+    return loadByte(address) | loadByte(address + 1) << 8;
+}
+
+const Memory::Region* Memory::findRegion(uint32_t address, uint32_t width) const {
+    for (const Region& region : regions_) {
+        if (address - region.base < region.size && region.size - (address - region.base) >= width)
+            return &region;
+    }
+    return nullptr;
+}
+
+// Map anonymous zero-filled pages for [base, base + size)
+void Memory::checkRegionFree(uint32_t base, uint64_t size) const {
+    if (size == 0) throw std::runtime_error("Empty memory region");
+    uint64_t end = uint64_t(base) + size;
+    if (end > 0x100000000ull) throw std::runtime_error("Memory region outside the 32-bit address space");
+    for (const Region& region : regions_) {
+        if (base < uint64_t(region.base) + region.size && region.base < end)
+            throw std::runtime_error("Memory regions overlap");
+    }
+}
+
+uint8_t* Memory::addRegion(uint32_t base, uint32_t size) {
+    checkRegionFree(base, size);
+    void* host = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (host == MAP_FAILED) throw std::runtime_error("Failed to map guest memory region");
+    regions_.push_back({base, size, static_cast<uint8_t*>(host), size, false});
+    return static_cast<uint8_t*>(host);
+}
+
+void Memory::mapDataImage(const std::string& filename, uint32_t base, uint64_t size) {
+    int fd = open(filename.c_str(), O_RDWR | (size ? O_CREAT : 0), 0644);
+    if (fd < 0) throw std::runtime_error("Failed to open data image " + filename);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to read data image " + filename);
+    }
+    // Region sizes are 32-bit, so a region ends at the top of memory at most one byte short of 4 GiB
+    if ((size ? size : static_cast<uint64_t>(st.st_size)) > UINT32_MAX) {
+        close(fd);
+        throw std::runtime_error("Data image " + filename + " does not fit in the 32-bit address space");
+    }
+    if (size > static_cast<uint64_t>(st.st_size) && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to grow data image " + filename);
+    }
+    if (size == 0) size = static_cast<uint64_t>(st.st_size);
+    try {
+        checkRegionFree(base, size);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    void* host = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (host == MAP_FAILED) throw std::runtime_error("Failed to map data image " + filename);
+    regions_.push_back({base, static_cast<uint32_t>(size), static_cast<uint8_t*>(host), size, true});
+}
+
+bool Memory::hasDataImage() const {
+    for (const Region& region : regions_)
+        if (region.shared) return true;
+    return false;
+}
+
+void Memory::syncDataImage() const {
+    for (const Region& region : regions_) {
+        if (region.shared && msync(region.host, region.mappedLength, MS_SYNC) != 0)
+            throw std::runtime_error("Failed to write back the data image");
+    }
+}
+
 // Check if a variable exists in the symbol table
 bool Memory::hasVariable(const std::string& name) const {
     return symbolTable_.count(name) > 0;
@@ -153,10 +335,14 @@ void Memory::setVariable(const std::string& name, uint32_t address) {
 // Save the data memory to a file
 void Memory::saveDataToFile(const std::string& dataFile) const {
     std::ofstream out(dataFile);
+    saveData(out);
+}
+
+void Memory::saveData(std::ostream& out) const {
     std::unordered_map<std::string,bool> visited; 
     for (const auto& [name, addr] : symbolTable_) {
         visited[std::to_string(addr)] = true; 
-        out << name << " " << addr << " " << data_.at(addr) << "\n";
+        out << name << " " << addr << " " << load(addr) << "\n";
     }
     for (const auto& [addr, value] : data_) {
         if (visited[std::to_string(addr)]) continue;
@@ -165,6 +351,35 @@ void Memory::saveDataToFile(const std::string& dataFile) const {
     }
 }
 
+// Fixed-width little-endian fields, maps in sorted order, so equal states give equal bytes
+static void appendWord(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+static void appendString(std::string& out, const std::string& s) {
+    appendWord(out, static_cast<uint32_t>(s.size()));
+    out += s;
+}
+
+void Memory::appendImage(std::string& out) const {
+    appendWord(out, static_cast<uint32_t>(program_.size()));
+    for (uint32_t word : program_) appendWord(out, word);
+    appendWord(out, static_cast<uint32_t>(symbolRefs_.size()));
+    for (const std::string& name : symbolRefs_) appendString(out, name);
+    std::map<std::string, uint32_t> symbols(symbolTable_.begin(), symbolTable_.end());
+    appendWord(out, static_cast<uint32_t>(symbols.size()));
+    for (const auto& [name, addr] : symbols) {
+        appendString(out, name);
+        appendWord(out, addr);
+    }
+    std::map<uint32_t, int32_t> data(data_.begin(), data_.end());
+    appendWord(out, static_cast<uint32_t>(data.size()));
+    for (const auto& [addr, value] : data) {
+        appendWord(out, addr);
+        appendWord(out, static_cast<uint32_t>(value));
+    }
+}
+
 // Get the names of all variables in the symbol table
 std::vector<std::string> Memory::getVariableNames() const {
     std::vector<std::string> names;
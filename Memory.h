@@ -1,29 +1,71 @@
 #pragma once
 #include <vector>
+#include <istream>
+#include <ostream>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <cstdint>
-#include "Instruction.h" 
+#include "Instruction.h"
+#include "Encoding.h"
 
 class Memory {
 public:
     // Constructor: accepts filenames for code and data
     Memory(std::string& codeFile, std::string& dataFile);
     Memory() = default; // Default constructor for empty memory
+    ~Memory();
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
 
     // Instruction memory
-    void insertInstructionsManually(std::string& codeFile);
-    void loadInstructionsFromFile(std::string& codeFile);
-    void loadInstructionsUsingFile(std::string& filename);
-    const Instruction& fetchInstruction(uint32_t pc) const;
+    // Both replace the program; the storage of the previous one is reused
+    void loadInstructions(std::string_view text);
+    void loadInstructionsUsingFile(const std::string& filename);
+    uint32_t fetchInstruction(uint32_t pc) const;
     size_t instructionCount() const;
 
+    // The instruction at pc, decoded once when the program was loaded
+    const DecodedInstruction& fetchDecoded(uint32_t pc) const { return decoded_[pc]; }
+
+    // Source text of the instruction at pc, kept for diagnostics only
+    std::string_view getSourceLine(uint32_t pc) const;
+    // Variable name referenced by an LA instruction word
+    const std::string& getSymbolRef(uint32_t index) const;
+
+    // Binary programs (ELF): instruction i lives at guest address base + 4 * i.
+    // Text programs are addressed by line, so both mappings are the identity.
+    void loadBinaryProgram(const uint32_t* words, size_t count, uint32_t base);
+    bool isBinaryProgram() const { return codeShift_ != 0; }
+    uint32_t codeAddress(uint32_t pc) const { return codeBase_ + (pc << codeShift_); }
+    uint32_t codeIndex(uint32_t address) const { return (address - codeBase_) >> codeShift_; }
+
     // Data memory
-    void loadVariablesFromFile(uint32_t& nextAddress, std::string& dataFile);
     void loadVariablesFromFile(const std::string& dataFile);
-    void manualVariableInput(uint32_t& nextAddress, std::string& dataFile);
+    void loadVariables(std::istream& in);
     void store(uint32_t address, int32_t value);
     int32_t load(uint32_t address) const;
+    void storeByte(uint32_t address, uint8_t value);
+    void storeHalf(uint32_t address, uint16_t value);
+    uint32_t loadByte(uint32_t address) const;
+    uint32_t loadHalf(uint32_t address) const;
+    // load() that reports an uninitialized address instead of throwing
+    bool tryLoad(uint32_t address, int32_t& value) const;
+    // Make an address uninitialized again (undo of a first store)
+    void forget(uint32_t address) { data_.erase(address); }
+
+    // Map a zero-filled, byte-addressable region of guest memory backed by host
+    // pages (ELF segments, stack). Accesses inside a region bypass the address map.
+    // Returns the host address of base; the pages are released with the Memory.
+    uint8_t* addRegion(uint32_t base, uint32_t size);
+
+    // Back guest memory from base with a file mapped MAP_SHARED: pages are read
+    // on demand and stores go straight to the file's pages, so nothing is parsed
+    // at load or serialized at exit. A non-zero size creates or grows the file.
+    void mapDataImage(const std::string& filename, uint32_t base, uint64_t size = 0);
+    bool hasDataImage() const;
+    // Flush the data image's dirty pages to its file
+    void syncDataImage() const;
 
     // Variable symbol table
     bool hasVariable(const std::string& name) const;
@@ -33,10 +75,54 @@ public:
     
     // Save/restore data memory
     void clear();
+    // Remember the current address map / return it to the remembered state.
+    // Host-backed regions (ELF segments, data image) are not included.
+    void snapshotData();
+    void restoreData();
     void saveDataToFile(const std::string& dataFile) const;
+    void saveData(std::ostream& out) const;
+
+    // Words held in the address map, and its approximate host size in bytes.
+    // The map never shrinks during a run, so after a run these are its peak.
+    size_t dataWordCount() const { return data_.size(); }
+    uint64_t dataFootprint() const;
+    // Host bytes of the mapped regions
+    uint64_t mappedBytes() const;
+
+    // Append a canonical byte image of the program and data memory to out:
+    // equal images run identically (used as the result cache key)
+    void appendImage(std::string& out) const;
 
 private:
-    std::vector<Instruction> program_; // Loaded instructions
+    struct Region {
+        uint32_t base;
+        uint32_t size;
+        uint8_t* host;
+        size_t mappedLength;
+        bool shared; // file-backed data image
+    };
+
+    // Region holding [address, address + width), or nullptr
+    const Region* findRegion(uint32_t address, uint32_t width) const;
+    void checkRegionFree(uint32_t base, uint64_t size) const;
+
+    // Assemble a line of text and append it to the program
+    void appendInstruction(const std::string& line);
+    void clearProgram();
+    // Size the program arrays up front so loading does not reallocate
+    void reserveProgram(size_t instructions, size_t sourceBytes);
+
+    // The program is split by access pattern: step() only touches decoded_,
+    // the rest is read when the program is saved, hashed or reported
+    std::vector<DecodedInstruction> decoded_; // Hot: predecoded instructions, 8 bytes each
+    std::vector<uint32_t> program_; // Loaded instructions, RV32I encoded
+    std::string sourceText_; // All source lines back to back
+    std::vector<uint32_t> sourceOffsets_; // Start of each line in sourceText_, then its end
+    std::vector<std::string> symbolRefs_; // Variables named by LA instructions
+    uint32_t codeBase_ = 0; // Guest address of the first instruction
+    uint32_t codeShift_ = 0; // log2 of the instruction stride in guest addresses
+    std::vector<Region> regions_; // Host-backed guest memory
     std::unordered_map<uint32_t, int32_t> data_; // Address→value
+    std::unordered_map<uint32_t, int32_t> initialData_; // data_ at snapshotData()
     std::unordered_map<std::string, uint32_t> symbolTable_; // Variable→address
 };
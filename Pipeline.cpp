@@ -0,0 +1,101 @@
+#include "Pipeline.h"
+#include <algorithm>
+#include <iomanip>
+
+PipelineModel::PipelineModel(const PipelineConfig& config) : config_(config) {}
+
+PipelineModel::Kind PipelineModel::kindOf(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::LW: case Opcode::LH: case Opcode::LB: case Opcode::LHU: case Opcode::LBU:
+            return Kind::LOAD;
+        case Opcode::SW: case Opcode::SH: case Opcode::SB:
+            return Kind::STORE;
+        case Opcode::BEQ: case Opcode::BNE: case Opcode::BLT: case Opcode::BGE:
+        case Opcode::BLTU: case Opcode::BGEU:
+            return Kind::BRANCH;
+        case Opcode::JAL:  return Kind::JUMP;
+        case Opcode::JALR: return Kind::JUMP_REG;
+        case Opcode::MUL:  return Kind::MUL;
+        default:           return Kind::ALU;
+    }
+}
+
+void PipelineModel::retire(uint32_t pc, const DecodedInstruction& inst, bool mispredicted, uint32_t memoryStall) {
+    if (pc >= pcStats_.size()) pcStats_.resize(pc + 1);
+    PCStats& stats = pcStats_[pc];
+    Kind kind = kindOf(inst.opcode);
+    ++stats.executed;
+    ++instructions_;
+
+    // Wait in ID until both operands can be forwarded (load-use and MUL hazards).
+    // Unused register fields decode as x0, which is always ready.
+    uint64_t ex = nextEX_;
+    uint64_t operandsReady = std::max(ready_[inst.rs1], ready_[inst.rs2]);
+    if (operandsReady > ex) {
+        stats.dataStalls += operandsReady - ex;
+        dataStalls_ += operandsReady - ex;
+        ex = operandsReady;
+    }
+    nextEX_ = ex + 1;
+
+    // A slow data access freezes the pipeline while it is in MEM
+    if (memoryStall) {
+        stats.memoryStalls += memoryStall;
+        memoryStalls_ += memoryStall;
+        nextEX_ += memoryStall;
+    }
+    lastWB_ = ex + 2 + memoryStall;
+
+    if (inst.rd != 0) {
+        switch (kind) {
+            case Kind::LOAD: ready_[inst.rd] = ex + 2 + memoryStall; break; // forwarded from MEM/WB
+            case Kind::MUL:  ready_[inst.rd] = ex + config_.mulLatency; break;
+            default:         ready_[inst.rd] = ex + 1; break;                // forwarded from EX/MEM
+        }
+    }
+
+    // Flush the wrongly fetched instructions after a control transfer
+    uint32_t penalty = 0;
+    if (kind == Kind::BRANCH && mispredicted) penalty = config_.branchPenalty;
+    else if (kind == Kind::JUMP) penalty = config_.jumpPenalty;
+    else if (kind == Kind::JUMP_REG) penalty = config_.branchPenalty;
+    if (penalty) {
+        stats.controlStalls += penalty;
+        controlStalls_ += penalty;
+        nextEX_ += penalty;
+    }
+}
+
+uint64_t PipelineModel::getCycles() const { return lastWB_; }
+
+double PipelineModel::getCPI() const {
+    return instructions_ ? static_cast<double>(getCycles()) / instructions_ : 0.0;
+}
+
+void PipelineModel::report(std::ostream& out, const Memory& memory) const {
+    std::ios_base::fmtflags flags = out.flags(); // the caller's formatting is restored at the end
+    std::streamsize precision = out.precision();
+    out << "\n==== Pipeline timing ====\n";
+    out << "Instructions: " << instructions_ << "\n";
+    out << "Cycles: " << getCycles() << "\n";
+    out << "CPI: " << std::fixed << std::setprecision(3) << getCPI() << "\n";
+    out << "Stall cycles: " << dataStalls_ << " data, " << controlStalls_ << " control, "
+        << memoryStalls_ << " memory\n";
+
+    bool header = false;
+    for (uint32_t pc = 0; pc < pcStats_.size(); ++pc) {
+        const PCStats& stats = pcStats_[pc];
+        if (!stats.dataStalls && !stats.controlStalls && !stats.memoryStalls) continue;
+        if (!header) {
+            out << "  PC    executed    data    control  memory   source\n";
+            header = true;
+        }
+        out << "  " << std::left << std::setw(6) << pc << std::setw(12) << stats.executed
+            << std::setw(8) << stats.dataStalls << std::setw(9) << stats.controlStalls
+            << std::setw(9) << stats.memoryStalls;
+        if (pc < memory.instructionCount()) out << memory.getSourceLine(pc);
+        out << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Encoding.h"
+#include "Memory.h"
+
+// Latencies and penalties of the modelled IF/ID/EX/MEM/WB pipeline
+struct PipelineConfig {
+    uint32_t branchPenalty = 2; // mispredicted branch, resolved in EX
+    uint32_t jumpPenalty = 1;   // JAL/JALR, target known in ID
+    uint32_t mulLatency = 3;    // EX cycles of MUL before its result can be forwarded
+};
+
+// Cycle-approximate timing of a classic 5-stage pipeline with full forwarding.
+// Rather than simulating every stage, the model streams over retired instructions
+// and keeps a per-register scoreboard of the cycle its value can be forwarded to EX,
+// so each retired instruction costs a handful of integer operations.
+class PipelineModel {
+public:
+    explicit PipelineModel(const PipelineConfig& config = PipelineConfig());
+
+    // Account for one retired instruction.
+    // mispredicted: a conditional branch went the other way than fetch assumed
+    // (taken, under the default predict-not-taken) and pays the branch penalty.
+    // memoryStall: cycles the data access spent beyond an L1 hit (0 without a cache model).
+    void retire(uint32_t pc, const DecodedInstruction& inst, bool mispredicted, uint32_t memoryStall);
+
+    uint64_t getInstructions() const { return instructions_; }
+    uint64_t getCycles() const;
+    double getCPI() const;
+
+    // Print totals and the stall attribution of every stalled instruction
+    void report(std::ostream& out, const Memory& memory) const;
+
+private:
+    enum class Kind : uint8_t { ALU, LOAD, STORE, MUL, BRANCH, JUMP, JUMP_REG };
+
+    // Per-PC stall attribution
+    struct PCStats {
+        uint64_t executed = 0;
+        uint64_t dataStalls = 0;
+        uint64_t controlStalls = 0;
+        uint64_t memoryStalls = 0;
+    };
+
+    static Kind kindOf(Opcode opcode);
+
+    PipelineConfig config_;
+    std::vector<PCStats> pcStats_;
+    uint64_t ready_[32] = {};   // cycle a register's value can be forwarded to EX
+    uint64_t nextEX_ = 3;       // earliest EX cycle of the next instruction (IF=1, ID=2)
+    uint64_t lastWB_ = 0;       // WB cycle of the last retired instruction
+    uint64_t instructions_ = 0;
+    uint64_t dataStalls_ = 0;
+    uint64_t controlStalls_ = 0;
+    uint64_t memoryStalls_ = 0;
+};
@@ -0,0 +1,184 @@
+#include "ResultCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Bumped whenever the key or entry layout changes, so old entries never match
+static const char ENTRY_MAGIC[] = "ASMRC2\n";
+static const size_t ENTRY_MAGIC_LENGTH = sizeof(ENTRY_MAGIC) - 1;
+
+// Temporary files older than this were left behind by a crashed writer
+static const auto STALE_TEMP_AGE = std::chrono::hours(1);
+
+// Names this cache writes: "<16 hex digits>.result" and, while an entry is
+// being written, "<16 hex digits>.result.tmp-<pid>-<sequence>"
+static bool isHashPrefix(const std::string& name) {
+    return name.size() >= 16 && name.find_first_not_of("0123456789abcdef") >= 16;
+}
+
+static bool isNumber(const std::string& text) {
+    return !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+static bool isEntryName(const std::string& name) {
+    return name.size() == 23 && isHashPrefix(name) && name.compare(16, std::string::npos, ".result") == 0;
+}
+
+static bool isTempName(const std::string& name) {
+    static const std::string marker = ".result.tmp-";
+    if (!isHashPrefix(name) || name.compare(16, marker.size(), marker) != 0) return false;
+    std::string rest = name.substr(16 + marker.size());
+    size_t dash = rest.find('-');
+    return dash != std::string::npos && isNumber(rest.substr(0, dash)) && isNumber(rest.substr(dash + 1));
+}
+
+// The file starts like an entry of this version
+static bool hasEntryMagic(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[ENTRY_MAGIC_LENGTH];
+    return in.read(magic, ENTRY_MAGIC_LENGTH) && std::equal(magic, magic + ENTRY_MAGIC_LENGTH, ENTRY_MAGIC);
+}
+
+// 64-bit FNV-1a
+static uint64_t hashBytes(const std::string& bytes) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t parseByteSize(const std::string& text) {
+    uint32_t shift = 0;
+    char unit = text.empty() ? '\0' : text.back();
+    if (unit == 'K' || unit == 'k') shift = 10;
+    else if (unit == 'M' || unit == 'm') shift = 20;
+    else if (unit == 'G' || unit == 'g') shift = 30;
+    std::string digits = shift ? text.substr(0, text.size() - 1) : text;
+    if (digits.empty() || digits.size() > 19 || !isNumber(digits)) throw std::runtime_error("Invalid size: " + text);
+    uint64_t value = std::stoull(digits);
+    if (value > (UINT64_MAX >> shift)) throw std::runtime_error("Size out of range: " + text);
+    return value << shift;
+}
+
+ResultCache::ResultCache(const std::string& directory, uint64_t maxBytes)
+    : directory_(directory), maxBytes_(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (!fs::is_directory(directory_)) throw std::runtime_error("Cannot create result cache directory " + directory_);
+}
+
+std::string ResultCache::makeKey(const Memory& memory, uint64_t budget) {
+    std::string key;
+    for (int i = 0; i < 8; ++i) key.push_back(static_cast<char>(budget >> (8 * i)));
+    memory.appendImage(key);
+    return key;
+}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.result", static_cast<unsigned long long>(hashBytes(key)));
+    return (fs::path(directory_) / name).string();
+}
+
+bool ResultCache::lookup(const std::string& key, std::string& result) const {
+    std::string path = entryPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string entry((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // magic, key length, key, result
+    size_t header = ENTRY_MAGIC_LENGTH + 8;
+    if (entry.size() < header || entry.compare(0, ENTRY_MAGIC_LENGTH, ENTRY_MAGIC) != 0) return false;
+    uint64_t keyLength = 0;
+    for (int i = 0; i < 8; ++i)
+        keyLength |= uint64_t(static_cast<unsigned char>(entry[ENTRY_MAGIC_LENGTH + i])) << (8 * i);
+    if (keyLength != key.size() || entry.size() < header + keyLength) return false;
+    if (entry.compare(header, keyLength, key) != 0) return false;
+    result = entry.substr(header + keyLength);
+
+    // Refresh the entry's age for eviction; losing this race to an evicting process is harmless
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void ResultCache::store(const std::string& key, const std::string& result) {
+    static std::atomic<uint32_t> sequence{0};
+    std::string path = entryPath(key);
+    std::ostringstream temp;
+    temp << path << ".tmp-" << getpid() << "-" << sequence++;
+
+    std::string entry(ENTRY_MAGIC, ENTRY_MAGIC_LENGTH);
+    for (int i = 0; i < 8; ++i) entry.push_back(static_cast<char>(uint64_t(key.size()) >> (8 * i)));
+    entry += key;
+    entry += result;
+    {
+        std::ofstream out(temp.str(), std::ios::binary | std::ios::trunc);
+        out.write(entry.data(), entry.size());
+        if (!out) {
+            std::remove(temp.str().c_str());
+            return; // A full or read-only cache only costs the re-run
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp.str(), path, ec);
+    if (ec) {
+        fs::remove(temp.str(), ec);
+        return;
+    }
+    evict();
+}
+
+// Remove the least recently used entries until the directory fits in maxBytes_.
+// Other processes may be evicting concurrently, so vanished files are skipped.
+// The directory may be shared with other files: only entries and temporary
+// files of this cache are counted or removed.
+void ResultCache::evict() const {
+    struct Entry {
+        fs::file_time_type time;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    auto now = fs::file_time_type::clock::now();
+    std::error_code ec;
+    for (fs::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code fileError;
+        if (!it->is_regular_file(fileError)) continue;
+        std::string name = it->path().filename().string();
+        bool entry = isEntryName(name);
+        if (!entry && !isTempName(name)) continue;
+        auto time = it->last_write_time(fileError);
+        uint64_t size = it->file_size(fileError);
+        if (fileError) continue;
+        if (!entry) {
+            if (now - time > STALE_TEMP_AGE) fs::remove(it->path(), fileError);
+            continue;
+        }
+        if (!hasEntryMagic(it->path())) continue;
+        entries.push_back({time, size, it->path()});
+        total += size;
+    }
+    if (total <= maxBytes_) return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const Entry& entry : entries) {
+        if (total <= maxBytes_) break;
+        fs::remove(entry.path, ec);
+        total -= entry.size;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Memory.h"
+
+// On-disk cache of run results, keyed by what determines them: the loaded
+// program, the initial data memory and the instruction budget.
+// Each entry is one file named by the key's hash. It holds the full key,
+// so a hash collision is a miss rather than a wrong result.
+// Entries are written to a temporary file and renamed into place, so
+// concurrent processes never see partial entries. When the directory grows
+// past maxBytes the least recently used entries are removed.
+class ResultCache {
+public:
+    ResultCache(const std::string& directory, uint64_t maxBytes);
+
+    // Key of a run of the program and data currently in memory
+    static std::string makeKey(const Memory& memory, uint64_t budget);
+
+    // On a hit, result receives the stored memory dump
+    bool lookup(const std::string& key, std::string& result) const;
+    void store(const std::string& key, const std::string& result);
+
+private:
+    std::string entryPath(const std::string& key) const;
+    void evict() const;
+
+    std::string directory_;
+    uint64_t maxBytes_;
+};
+
+// Parse a byte count with an optional K/M/G suffix
+uint64_t parseByteSize(const std::string& text);
@@ -0,0 +1,109 @@
+#include "RunStats.h"
+#include "CPU.h"
+#include <bitset>
+#include <cstdio>
+#include <iomanip>
+#include <sys/resource.h>
+
+void RunStats::addPhase(const std::string& name, double seconds) {
+    for (auto& phase : phases_) {
+        if (phase.first == name) {
+            phase.second += seconds;
+            return;
+        }
+    }
+    phases_.emplace_back(name, seconds);
+}
+
+static const char* engineName(Engine engine) {
+    switch (engine) {
+        case Engine::CHECKED: return "checked";
+        case Engine::TRACE:   return "trace";
+        case Engine::FAST:    return "fast";
+    }
+    return "?";
+}
+
+// JSON string literal
+static std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+void RunStats::writeJson(std::ostream& out, const CPU& cpu, const std::string& program, const std::string& data) const {
+    const Memory& memory = *cpu.getMemory();
+    double total = 0, execute = 0;
+    for (const auto& phase : phases_) {
+        total += phase.second;
+        if (phase.first == "execute") execute = phase.second;
+    }
+    uint64_t retired = cpu.getInstret();
+
+    std::streamsize precision = out.precision(9); // restored at the end
+    out << "{\n";
+    out << "  \"program\": " << quote(program) << ",\n";
+    out << "  \"data\": " << quote(data) << ",\n";
+    out << "  \"engine\": \"" << engineName(cpu.getEngine()) << "\",\n";
+    out << "  \"program_instructions\": " << memory.instructionCount() << ",\n";
+    out << "  \"exit_code\": " << cpu.getExitCode() << ",\n";
+    out << "  \"budget_exhausted\": " << (cpu.budgetExhausted() ? "true" : "false") << ",\n";
+    out << "  \"phases_seconds\": {";
+    for (size_t i = 0; i < phases_.size(); ++i)
+        out << (i ? ", " : "") << quote(phases_[i].first) << ": " << phases_[i].second;
+    out << "},\n";
+    out << "  \"total_seconds\": " << total << ",\n";
+    out << "  \"instructions_retired\": " << retired << ",\n";
+    out << "  \"cycles\": " << cpu.getCycles() << ",\n";
+    out << "  \"mips\": " << (execute > 0 ? retired / execute / 1e6 : 0.0) << ",\n";
+
+    // Opcode mix from the per-PC counts, in opcode order; absent for the fast engine
+    if (!executions_.empty()) {
+        std::vector<uint64_t> mix(size_t(Opcode::INVALID) + 1, 0);
+        for (uint32_t pc = 0; pc < executions_.size() && pc < memory.instructionCount(); ++pc)
+            mix[size_t(memory.fetchDecoded(pc).opcode)] += executions_[pc];
+        out << "  \"opcode_mix\": {";
+        bool first = true;
+        for (size_t op = 0; op < mix.size(); ++op) {
+            if (!mix[op]) continue;
+            out << (first ? "" : ", ") << "\"" << Instruction::opcodeToString(Opcode(op)) << "\": " << mix[op];
+            first = false;
+        }
+        out << "},\n";
+    }
+
+    out << "  \"memory\": {";
+    out << "\"data_words\": " << memory.dataWordCount();
+    out << ", \"data_bytes\": " << memory.dataFootprint();
+    out << ", \"mapped_bytes\": " << memory.mappedBytes();
+    if (!executions_.empty()) {
+        uint64_t words = 0, pages = 0;
+        for (const auto& chunk : touched_) {
+            if (!chunk) continue;
+            for (uint32_t page = 0; page < CHUNK_WORDS / 1024; ++page) {
+                uint64_t pageWords = 0;
+                for (uint32_t i = 0; i < 16; ++i) pageWords += std::bitset<64>(chunk[page * 16 + i]).count();
+                words += pageWords;
+                pages += pageWords != 0;
+            }
+        }
+        out << ", \"touched_words\": " << words << ", \"touched_pages\": " << pages;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    out << ", \"peak_rss_kb\": " << usage.ru_maxrss << "},\n";
+    out << "  \"console_bytes\": " << cpu.getConsole().bytesWritten() << "\n";
+    out << "}\n";
+    out.precision(precision);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CPU;
+
+// Statistics of one run, written as a single JSON object so that reports of
+// many runs can be aggregated: wall time per phase, instructions retired and
+// MIPS, the executed opcode mix and the data memory footprint.
+// The checked and trace engines count executions per PC (the opcode mix is
+// derived from them when the report is written) and mark every accessed data
+// word in a sparse bitmap, whose chunk table is only allocated by the first
+// access. The fast engine counts neither, so the interpreter does not offer
+// the report with --fast.
+class RunStats {
+public:
+    // Add wall time to a phase ("parse", "data_load", "execute", "save", ...);
+    // phases are reported in the order they first appear
+    void addPhase(const std::string& name, double seconds);
+
+    // Hooks of the CPU for each executed instruction and each data access
+    void countExecution(uint32_t pc) {
+        if (pc >= executions_.size()) executions_.resize(pc + 1);
+        ++executions_[pc];
+    }
+    void touch(uint32_t address) {
+        if (touched_.empty()) touched_.resize(size_t(1) << (32 - CHUNK_BITS));
+        std::unique_ptr<uint64_t[]>& chunk = touched_[address >> CHUNK_BITS];
+        if (!chunk) chunk.reset(new uint64_t[CHUNK_WORDS / 64]());
+        uint32_t word = (address >> 2) & (CHUNK_WORDS - 1);
+        chunk[word >> 6] |= uint64_t(1) << (word & 63);
+    }
+
+    // program and data name the inputs (file names) for the reader
+    void writeJson(std::ostream& out, const CPU& cpu, const std::string& program, const std::string& data) const;
+
+private:
+    static const uint32_t CHUNK_BITS = 14; // 16 KiB of guest memory per bitmap chunk
+    static const uint32_t CHUNK_WORDS = 1u << (CHUNK_BITS - 2);
+
+    std::vector<std::pair<std::string, double>> phases_;
+    std::vector<uint64_t> executions_; // times each PC was executed
+    std::vector<std::unique_ptr<uint64_t[]>> touched_; // one bit per accessed word
+};
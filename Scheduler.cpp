@@ -0,0 +1,176 @@
+#include "Scheduler.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+const char* jobStateName(JobState state) {
+    switch (state) {
+        case JobState::QUEUED:           return "queued";
+        case JobState::RUNNING:          return "running";
+        case JobState::FINISHED:         return "finished";
+        case JobState::FAILED:           return "failed";
+        case JobState::BUDGET_EXHAUSTED: return "budget";
+        case JobState::CANCELLED:        return "cancelled";
+    }
+    return "?";
+}
+
+void Scheduler::WorkQueue::pushBack(Job* job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+}
+
+Scheduler::Job* Scheduler::WorkQueue::popFront() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) return nullptr;
+    Job* job = jobs.front();
+    jobs.pop_front();
+    return job;
+}
+
+Scheduler::Job* Scheduler::WorkQueue::popBack() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) return nullptr;
+    Job* job = jobs.back();
+    jobs.pop_back();
+    return job;
+}
+
+Scheduler::Scheduler(unsigned workers, uint64_t quantum)
+    : quantum_(quantum), queues_(std::max(1u, workers)) {
+    if (quantum_ == 0) throw std::runtime_error("Scheduler quantum must be positive");
+}
+
+size_t Scheduler::submit(std::unique_ptr<CPU> cpu, const std::string& name, unsigned priority, uint64_t budget) {
+    auto job = std::make_unique<Job>();
+    job->id = jobs_.size();
+    job->name = name;
+    job->cpu = std::move(cpu);
+    job->priority = std::max(1u, priority);
+    job->budget = budget;
+    job->submitted = Clock::now();
+    jobs_.push_back(std::move(job));
+    return jobs_.back()->id;
+}
+
+void Scheduler::cancel(size_t id) {
+    jobs_.at(id)->cancelRequested = true;
+}
+
+void Scheduler::run() {
+    // Deal the queued jobs out round-robin, highest priority first so it starts first
+    std::vector<Job*> pending;
+    for (auto& job : jobs_)
+        if (job->state == JobState::QUEUED) pending.push_back(job.get());
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Job* a, const Job* b) { return a->priority > b->priority; });
+    for (size_t i = 0; i < pending.size(); ++i) queues_[i % queues_.size()].pushBack(pending[i]);
+    remaining_ = pending.size();
+
+    Clock::time_point start = Clock::now();
+    deadline_ = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeLimit_));
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < queues_.size(); ++i) workers.emplace_back(&Scheduler::workerLoop, this, i);
+    for (std::thread& worker : workers) worker.join();
+    wallSeconds_ += std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void Scheduler::workerLoop(unsigned self) {
+    unsigned idleRounds = 0;
+    while (remaining_ > 0) {
+        Job* job = takeJob(self);
+        if (!job) {
+            // Everything left is running on other workers; back off until it is requeued
+            if (++idleRounds < 64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        idleRounds = 0;
+        if (runQuantum(*job)) queues_[self].pushBack(job);
+    }
+}
+
+Scheduler::Job* Scheduler::takeJob(unsigned self) {
+    if (Job* job = queues_[self].popFront()) return job;
+    for (size_t k = 1; k < queues_.size(); ++k) {
+        if (Job* job = queues_[(self + k) % queues_.size()].popBack()) {
+            ++steals_;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::runQuantum(Job& job) {
+    Clock::time_point start = Clock::now();
+    if (job.stats.quanta == 0) job.stats.waitSeconds = std::chrono::duration<double>(start - job.submitted).count();
+    if (job.cancelRequested || (timeLimit_ > 0 && start >= deadline_)) {
+        complete(job, JobState::CANCELLED);
+        return false;
+    }
+    job.state = JobState::RUNNING;
+
+    uint64_t slice = quantum_ * job.priority;
+    if (job.budget) slice = std::min(slice, job.budget - job.stats.instructions);
+    uint64_t executed = 0;
+    bool failed = false;
+    try {
+        executed = job.cpu->runSlice(slice);
+    } catch (const std::exception& e) {
+        job.error = e.what();
+        failed = true;
+    }
+    job.stats.instructions += executed;
+    ++job.stats.quanta;
+    job.stats.runSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (failed) complete(job, JobState::FAILED);
+    else if (executed < slice || job.cpu->halted()) complete(job, JobState::FINISHED);
+    else if (job.budget && job.stats.instructions >= job.budget) complete(job, JobState::BUDGET_EXHAUSTED);
+    else return true;
+    return false;
+}
+
+void Scheduler::complete(Job& job, JobState state) {
+    job.cpu->getConsole().flush();
+    job.stats.latencySeconds = std::chrono::duration<double>(Clock::now() - job.submitted).count();
+    job.state = state;
+    --remaining_;
+}
+
+void Scheduler::report(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags(); // the caller's formatting is restored at the end
+    std::streamsize precision = out.precision();
+    out << "\nScheduler: " << jobs_.size() << " jobs on " << queues_.size() << " workers, quantum "
+        << quantum_ << " instructions, " << steals_ << " steals\n";
+    out << "  " << std::left << std::setw(6) << "id" << std::setw(11) << "state" << std::setw(5) << "prio"
+        << std::right << std::setw(14) << "instructions" << std::setw(8) << "quanta" << std::setw(11) << "wait ms"
+        << std::setw(11) << "run ms" << std::setw(12) << "latency ms" << "   job\n";
+    uint64_t totalInstructions = 0;
+    std::vector<double> latencies;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& job : jobs_) {
+        const JobStats& s = job->stats;
+        out << "  " << std::left << std::setw(6) << job->id << std::setw(11) << jobStateName(job->state)
+            << std::setw(5) << job->priority << std::right << std::setw(14) << s.instructions
+            << std::setw(8) << s.quanta << std::setw(11) << s.waitSeconds * 1e3
+            << std::setw(11) << s.runSeconds * 1e3 << std::setw(12) << s.latencySeconds * 1e3
+            << "   " << job->name;
+        if (!job->error.empty()) out << "  " << job->error;
+        out << "\n";
+        totalInstructions += s.instructions;
+        latencies.push_back(s.latencySeconds);
+    }
+    out << "Total: " << totalInstructions << " instructions in " << wallSeconds_ << " s";
+    if (wallSeconds_ > 0) out << " (" << totalInstructions / wallSeconds_ / 1e6 << " MIPS)";
+    out << "\n";
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] * 1e3; };
+        out << "Latency ms: p50 " << percentile(0.5) << ", p99 " << percentile(0.99)
+            << ", max " << latencies.back() * 1e3 << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
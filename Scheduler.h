@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+enum class JobState { QUEUED, RUNNING, FINISHED, FAILED, BUDGET_EXHAUSTED, CANCELLED };
+
+const char* jobStateName(JobState state);
+
+// Runs many guest programs on a fixed pool of worker threads.
+// Jobs are time-sliced in quanta of instructions (CPU::runSlice): after each
+// quantum an unfinished job goes to the back of its worker's queue, so a job
+// that loops forever only ever holds a worker for one quantum and can be
+// stopped by its budget, the time limit or cancel(). Each worker has its own
+// queue and steals from the others when it runs dry. A job's priority
+// multiplies its quantum, giving it a proportionally larger share of the
+// instructions executed.
+class Scheduler {
+public:
+    struct JobStats {
+        std::atomic<uint64_t> instructions{0}; // progress, readable while running
+        uint64_t quanta = 0;
+        double waitSeconds = 0;    // submit to first quantum
+        double runSeconds = 0;     // time spent executing
+        double latencySeconds = 0; // submit to completion
+    };
+
+    explicit Scheduler(unsigned workers, uint64_t quantum = 10000);
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Queue a loaded CPU; returns the job id. budget 0 means no instruction limit.
+    size_t submit(std::unique_ptr<CPU> cpu, const std::string& name, unsigned priority = 1, uint64_t budget = 0);
+
+    // Stop a job at its next quantum boundary (safe while run() is executing)
+    void cancel(size_t id);
+
+    // Cancel the jobs still unfinished this many seconds into run() (0 = no limit)
+    void setTimeLimit(double seconds) { timeLimit_ = seconds; }
+
+    // Execute every submitted job, returning when all have completed
+    void run();
+
+    size_t jobCount() const { return jobs_.size(); }
+    JobState getState(size_t id) const { return jobs_.at(id)->state; }
+    const JobStats& getStats(size_t id) const { return jobs_.at(id)->stats; }
+    const std::string& getName(size_t id) const { return jobs_.at(id)->name; }
+    const std::string& getError(size_t id) const { return jobs_.at(id)->error; }
+    CPU& getCPU(size_t id) { return *jobs_.at(id)->cpu; }
+
+    // Per-job statistics followed by totals and latency percentiles
+    void report(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        size_t id;
+        std::string name;
+        std::unique_ptr<CPU> cpu;
+        unsigned priority;
+        uint64_t budget;
+        std::atomic<JobState> state{JobState::QUEUED};
+        std::atomic<bool> cancelRequested{false};
+        std::string error;
+        Clock::time_point submitted;
+        JobStats stats;
+    };
+
+    // A worker's run queue; the owner works at the front, thieves take from the back
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Job*> jobs;
+
+        void pushBack(Job* job);
+        Job* popFront();
+        Job* popBack();
+    };
+
+    void workerLoop(unsigned self);
+    Job* takeJob(unsigned self);
+    // Run one quantum of job; true if it has to be queued again
+    bool runQuantum(Job& job);
+    void complete(Job& job, JobState state);
+
+    uint64_t quantum_;
+    std::vector<std::unique_ptr<Job>> jobs_;
+    std::vector<WorkQueue> queues_;
+    std::atomic<size_t> remaining_{0};
+    std::atomic<uint64_t> steals_{0};
+    double wallSeconds_ = 0;
+    double timeLimit_ = 0;
+    Clock::time_point deadline_;
+};
@@ -0,0 +1,79 @@
+#include "Watchpoint.h"
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+WatchpointSet::WatchpointSet(Callback callback)
+    : callback_(std::move(callback)), pageFlags_(size_t(1) << (32 - PAGE_BITS), 0) {}
+
+void WatchpointSet::add(const std::string& name, uint32_t address, uint32_t size) {
+    if (size == 0 || uint64_t(address) + size > (uint64_t(1) << 32))
+        throw std::runtime_error("Invalid watch range for " + name);
+    watches_.push_back({name, address, size});
+    for (uint64_t page = address >> PAGE_BITS; page <= (uint64_t(address) + size - 1) >> PAGE_BITS; ++page)
+        pageFlags_[page] = 1;
+}
+
+// Decimal or 0x hex number that fits in 32 bits
+static uint32_t parseNumber(const std::string& text) {
+    size_t pos = 0;
+    unsigned long long value = 0;
+    if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0]))) value = std::stoull(text, &pos, 0);
+    if (pos == 0 || pos != text.size() || value > UINT32_MAX) throw std::out_of_range("Invalid watch number: " + text);
+    return static_cast<uint32_t>(value);
+}
+
+void WatchpointSet::addFromSpec(const std::string& spec, const Memory& memory) {
+    std::stringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.empty()) continue;
+        if (!std::isdigit(static_cast<unsigned char>(item[0]))) {
+            if (!memory.hasVariable(item)) throw std::runtime_error("Unknown variable to watch: " + item);
+            add(item, memory.getVariableAddress(item), 4);
+            continue;
+        }
+        size_t colon = item.find(':');
+        try {
+            uint32_t address = parseNumber(item.substr(0, colon));
+            uint32_t size = colon == std::string::npos ? 4 : parseNumber(item.substr(colon + 1));
+            add(item, address, size);
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Invalid watch: " + item);
+        }
+    }
+}
+
+bool WatchpointSet::overlaps(uint32_t address, uint32_t width) const {
+    for (const Watch& watch : watches_)
+        if (watch.overlaps(address, width)) return true;
+    return false;
+}
+
+void WatchpointSet::notify(WatchHit hit) {
+    for (Watch& watch : watches_) {
+        if (!watch.overlaps(hit.address, hit.width)) continue;
+        ++hits_;
+        ++watch.hits;
+        hit.watch = watch.name;
+        callback_(hit);
+    }
+}
+
+void WatchpointSet::printHit(std::ostream& out, const WatchHit& hit) {
+    out << "watch " << hit.watch << ": [" << hit.address << "] ";
+    if (hit.hadValue) out << hit.oldValue;
+    else out << "(unset)";
+    out << " -> " << hit.newValue << " at PC " << hit.pc;
+    if (!hit.source.empty()) out << ": " << hit.source;
+    out << "\n";
+}
+
+void WatchpointSet::report(std::ostream& out) const {
+    out << "\nWatchpoints: " << hits_ << " hits\n";
+    for (const Watch& watch : watches_) {
+        out << "  " << std::left << std::setw(20) << watch.name << std::right << " [" << watch.address
+            << ", +" << watch.size << ")  " << watch.hits << " hits\n";
+    }
+}
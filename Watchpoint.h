@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Memory.h"
+
+// A store that touched a watched range
+struct WatchHit {
+    std::string_view watch;   // name of the watchpoint hit
+    uint32_t pc;
+    uint32_t address;         // first byte written
+    uint32_t width;           // bytes written (1, 2 or 4)
+    bool hadValue;            // false if the location was never written before
+    int32_t oldValue;         // the width bytes before and after the store
+    int32_t newValue;
+    std::string_view source;  // source line of the storing instruction (empty for ELF)
+};
+
+// Data watchpoints on variables or address ranges.
+// Every 4 KiB page of the guest address space has a flag that is set while a
+// watchpoint covers part of it. A store first tests the flag of its page, so
+// stores to unwatched pages cost one byte load; only stores to flagged pages
+// look up the ranges, and only real hits read the old value and call back.
+// The checked and trace engines test watchpoints; the fast engine does not.
+class WatchpointSet {
+public:
+    using Callback = std::function<void(const WatchHit&)>;
+
+    static const uint32_t PAGE_BITS = 12;
+
+    explicit WatchpointSet(Callback callback);
+
+    // Watch [address, address + size)
+    void add(const std::string& name, uint32_t address, uint32_t size);
+
+    // Add a comma separated list of variable names (one word each), ADDR or
+    // ADDR:LEN (decimal or 0x hex); names are resolved in memory's symbol table
+    void addFromSpec(const std::string& spec, const Memory& memory);
+
+    // Could a store of width bytes at address hit a watchpoint (page flag test)
+    bool mayHit(uint32_t address, uint32_t width) const {
+        return pageFlags_[address >> PAGE_BITS] | pageFlags_[(address + width - 1) >> PAGE_BITS];
+    }
+
+    // Does a watchpoint overlap [address, address + width)
+    bool overlaps(uint32_t address, uint32_t width) const;
+
+    // Count a hit of every watchpoint the store overlaps and pass each one to
+    // the callback, with watch naming it
+    void notify(WatchHit hit);
+
+    uint64_t hitCount() const { return hits_; }
+
+    // One line per hit: watch, address, old -> new value, PC and source line
+    static void printHit(std::ostream& out, const WatchHit& hit);
+
+    // Hit count of each watchpoint
+    void report(std::ostream& out) const;
+
+private:
+    struct Watch {
+        std::string name;
+        uint32_t address;
+        uint32_t size;
+        uint64_t hits = 0;
+
+        bool overlaps(uint32_t start, uint32_t width) const {
+            return uint64_t(start) + width > address && start < uint64_t(address) + size;
+        }
+    };
+
+    Callback callback_;
+    std::vector<Watch> watches_;
+    std::vector<uint8_t> pageFlags_; // one per page of the 4 GiB guest space
+    uint64_t hits_ = 0;
+};
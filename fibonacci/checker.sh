@@ -1,7 +1,7 @@
 #!/bin/bash
 
 # Step 1: Compile the program (change main.cpp to your file if necessary)
-g++ -o my_executable ../interpreter.cpp ../CPU.cpp ../Instruction.cpp ../Memory.cpp
+g++ -pthread -o my_executable ../*.cpp
 if [ $? -ne 0 ]; then
     echo "Compilation failed!"
     exit 1
@@ -51,6 +51,27 @@ EOF
     fi
 done
 
+# Writing x0 in the middle of a program is an error, it must not end the program
+printf "LI x1, 5\nADDI x0, x0, 0\nLA x5, result\nSW x1, 0(x5)\n" > x0_write.txt
+printf "result 4 0\n" > x0_write_data.txt
+(printf "1\n2\nx0_write.txt\n2\n2\nx0_write_data.txt\n3\n" | $EXECUTABLE) > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    echo "Testcase x0_write: Failed (ADDI x0, x0, 0 was accepted)"
+    all_passed=false
+fi
+rm -f x0_write.txt x0_write_data.txt "$RECEIVED_FILE"
+
+# An incremental rerun of a program with lines appended after its exit must not run them
+printf "LI x17, 10\nECALL\n" > exit_first.txt
+printf "LI x17, 10\nECALL\nLA x5, result\nLI x6, 7\nSW x6, 0(x5)\n" > exit_appended.txt
+printf "result 0 1\n" > exit_data.txt
+printf "1\n2\nexit_first.txt\n2\n2\nexit_data.txt\n3\n1\n2\nexit_appended.txt\n3\n0\n" | $EXECUTABLE --incremental > /dev/null 2>&1
+if ! diff -q <(echo "result 0 1") "$RECEIVED_FILE" > /dev/null 2>&1; then
+    echo "Testcase incremental_exit: Failed (lines after the exit ran)"
+    all_passed=false
+fi
+rm -f exit_first.txt exit_appended.txt exit_data.txt "$RECEIVED_FILE"
+
 if $all_passed; then
     echo "All outputs matched expected results!"
 else
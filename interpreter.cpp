@@ -1,6 +1,17 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "CPU.h"
+#include "Incremental.h"
+#include "ResultCache.h"
+#include "Scheduler.h"
 
 void showMenu() {
     std::cout << "\n==== Assembly Simulator ====\n";
@@ -11,6 +22,46 @@ void showMenu() {
     std::cout << "\nEnter your choice: ";
 }
 
+// Read "name value" pairs until "exit", allotting consecutive words from nextAddress
+void manualVariableInput(Memory* memory, uint32_t& nextAddress, std::string& dataFile) {
+    memory->clear(); // Clear existing variables
+    dataFile = "new_data.txt"; // Default output file name
+    while(true) {
+        //std::cout << "Enter variable name (or 'exit' to stop): ";
+        // remove the above comment in case of interactive mode
+        std::string varName;
+        std::cin >> varName;
+        if (varName == "exit") break;
+
+        // std::cout << "Enter variable value: ";
+        // remove the above comment in case of interactive mode
+        int32_t value;
+        std::cin >> value;
+
+        memory->setVariable(varName, nextAddress);
+        memory->store(nextAddress, value);
+        nextAddress += 4; // Assume word-aligned, 4-byte variables
+    }
+}
+
+// Load variables from a file named by the user
+void loadVariablesFromFile(Memory* memory, uint32_t& nextAddress, std::string& dataFile) {
+    memory->clear(); // Clear existing variables
+    // std::cout << "Enter the data file name: "; 
+    // remove the above comment in case of interactive mode
+    std::string filename;
+    std::cin >> filename;
+    std::cin.ignore();
+    dataFile = filename; 
+    memory->loadVariablesFromFile(filename);
+    uint32_t maxAddr = 0;
+    for (const auto& name : memory->getVariableNames()) {
+        uint32_t addr = memory->getVariableAddress(name);
+        if (addr > maxAddr) maxAddr = addr;
+    }
+    nextAddress = maxAddr + 4;
+}
+
 void dataEntryOptions(Memory* memory, uint32_t& nextAddress, std::string& dataFile) {
     // std::cout << "\n1. Manual variable entry\n";
     // std::cout << "2. Load variables from file\n";
@@ -19,10 +70,10 @@ void dataEntryOptions(Memory* memory, uint32_t& nextAddress, std::string& dataFi
     std::cin >> choice;
     switch (choice) {
         case 1:
-            memory->manualVariableInput(nextAddress, dataFile);
+            manualVariableInput(memory, nextAddress, dataFile);
             break;
         case 2:
-            memory->loadVariablesFromFile(nextAddress, dataFile);
+            loadVariablesFromFile(memory, nextAddress, dataFile);
             break;
         case 3:
             return; // Go back to main menu
@@ -31,6 +82,30 @@ void dataEntryOptions(Memory* memory, uint32_t& nextAddress, std::string& dataFi
     }
 }
 
+// Read instructions (one per line, empty line to finish), for interactive mode
+void insertInstructionsManually(Memory* memory, std::string& codeFile) {
+    // std::cout << "Enter instructions (one per line, empty line to finish):\n";
+    // remove the above comment in case of interactive mode
+    codeFile = "new_instructions.txt"; 
+    std::string text, line;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) break; // Stop on empty line
+        text += line;
+        text += '\n';
+    }
+    memory->loadInstructions(text);
+}
+
+// Load instructions from a file named by the user
+void loadInstructionsFromFile(Memory* memory, std::string& codeFile) {
+    // std::cout << "Enter the instruction file name: ";
+    // remove the above comment in case of interactive mode
+    std::string filename;
+    std::cin >> filename;
+    codeFile = filename; 
+    memory->loadInstructionsUsingFile(filename);
+}
+
 void InstructionEntryOptions(Memory* memory, std::string &codeFile) {
     // std::cout << "\n1. Insert instructions manually\n";
     // std::cout << "2. Load instructions from file\n";
@@ -39,10 +114,10 @@ void InstructionEntryOptions(Memory* memory, std::string &codeFile) {
     std::cin >> choice;
     switch (choice) {
         case 1:
-            memory->insertInstructionsManually(codeFile);
+            insertInstructionsManually(memory, codeFile);
             break;
         case 2:
-            memory->loadInstructionsFromFile(codeFile);
+            loadInstructionsFromFile(memory, codeFile);
             break;
         case 3:
             return; // Go back to main menu
@@ -51,37 +126,380 @@ void InstructionEntryOptions(Memory* memory, std::string &codeFile) {
     }
 }
 
-int main() {
+// Largest job priority; a priority multiplies the quantum, so it is kept small
+const uint64_t MAX_BATCH_PRIORITY = 1000;
+
+// Decimal option value or batch line field within [min, max]
+uint64_t parseNumber(const std::string& field, uint64_t min, uint64_t max) {
+    bool digits = !field.empty() && field.find_first_not_of("0123456789") == std::string::npos;
+    uint64_t number = 0;
+    try {
+        if (digits) number = std::stoull(field);
+    } catch (const std::out_of_range&) {
+        digits = false;
+    }
+    if (!digits || number < min || number > max)
+        throw std::runtime_error(field + " is not a number from " + std::to_string(min) + " to " + std::to_string(max));
+    return number;
+}
+
+// Non-negative number of seconds, fractions allowed
+double parseSeconds(const std::string& field) {
+    size_t pos = 0;
+    double seconds = -1;
+    try {
+        seconds = std::stod(field, &pos);
+    } catch (const std::logic_error&) {
+    }
+    if (pos != field.size() || !(seconds >= 0 && seconds <= 1e9))
+        throw std::runtime_error(field + " is not a number of seconds");
+    return seconds;
+}
+
+// Run every job of a batch file on the scheduler. Each line is
+//   PROGRAM DATA OUTPUT [PRIORITY [BUDGET]]
+// and each finished job's memory is saved to its OUTPUT file. Jobs without a
+// budget of their own get defaultBudget (0 = no limit); jobs still running
+// timeLimit seconds into the batch (0 = no limit) are cancelled.
+int runBatch(const std::string& batchFile, unsigned workers, uint64_t quantum, Engine engine,
+             uint64_t defaultBudget, double timeLimit) {
+    std::ifstream in(batchFile);
+    if (!in) throw std::runtime_error("Failed to open batch file.");
+    Scheduler scheduler(workers, quantum);
+    scheduler.setTimeLimit(timeLimit);
+    std::vector<std::string> outputs;
+    int failures = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string program, data, output, priorityField, budgetField, extra;
+        if (!(fields >> program >> data >> output)) continue;
+        fields >> priorityField >> budgetField >> extra;
+        unsigned priority = 1;
+        uint64_t budget = defaultBudget;
+        try {
+            if (!extra.empty()) throw std::runtime_error("too many fields");
+            if (!priorityField.empty()) priority = parseNumber(priorityField, 1, MAX_BATCH_PRIORITY);
+            if (!budgetField.empty()) budget = parseNumber(budgetField, 0, UINT64_MAX);
+        } catch (const std::exception& e) {
+            std::cerr << "Invalid batch line \"" << line << "\": " << e.what() << "\n";
+            ++failures;
+            continue;
+        }
+        std::unique_ptr<CPU> cpu;
+        try {
+            cpu = std::make_unique<CPU>(program, data);
+        } catch (const std::exception& e) { // one bad job does not stop the batch
+            std::cerr << program << " " << data << ": " << e.what() << "\n";
+            ++failures;
+            continue;
+        }
+        cpu->setEngine(engine);
+        scheduler.submit(std::move(cpu), program + " " + data, priority, budget);
+        outputs.push_back(output);
+    }
+    scheduler.run();
+
+    for (size_t id = 0; id < scheduler.jobCount(); ++id) {
+        JobState state = scheduler.getState(id);
+        if (state == JobState::FINISHED || state == JobState::BUDGET_EXHAUSTED)
+            scheduler.getCPU(id).getMemory()->saveDataToFile(outputs[id]);
+        else
+            ++failures;
+    }
+    scheduler.report(std::cout);
+    return failures ? 1 : 0;
+}
+
+// Matches a command line option of the form --name=value
+bool parseOption(const std::string& arg, const std::string& name, std::string& value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+// Wall time since start, for the phases of --stats
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void showUsage() {
+    std::cout << "Options:\n";
+    std::cout << "  --l1=SIZE:ASSOC:LINE[:LATENCY]   simulate an L1 data cache (e.g. 32K:4:64)\n";
+    std::cout << "  --l2=SIZE:ASSOC:LINE[:LATENCY]   add an L2 behind the L1 (e.g. 256K:8:64:10)\n";
+    std::cout << "  --cache-replacement=lru|random   replacement policy (default lru)\n";
+    std::cout << "  --cache-write=back|through       write policy (default back)\n";
+    std::cout << "  --mem-latency=CYCLES             main memory latency (default 100)\n";
+    std::cout << "  --timing                         model a 5-stage pipeline and report cycles/CPI\n";
+    std::cout << "  --branch-penalty=CYCLES          taken branch penalty (default 2)\n";
+    std::cout << "  --mul-latency=CYCLES             MUL result latency (default 3)\n";
+    std::cout << "  --bp=NAME[,NAME...]              compare branch predictors: static, taken, not-taken,\n";
+    std::cout << "                                   bimodal, gshare, tournament (first one drives --timing)\n";
+    std::cout << "  --bp-bits=N                      predictor table index bits (default 10)\n";
+    std::cout << "  --bp-history=N                   global history bits (default 8)\n";
+    std::cout << "  --max-instructions=N             stop the program after N instructions\n";
+    std::cout << "  --result-cache=DIR               reuse results of identical (program, data) runs\n";
+    std::cout << "  --result-cache-size=BYTES        result cache size limit, K/M/G suffixes (default 64M)\n";
+    std::cout << "  --console=FILE                   write the program's printed output to FILE instead of stdout\n";
+    std::cout << "  --data-image=FILE                back data memory from address 0 with FILE (mapped, written in place)\n";
+    std::cout << "  --data-image-size=BYTES          create or grow the data image to BYTES, K/M/G suffixes\n";
+    std::cout << "  --counters=FILE                  write the cycle/instret/time counters after the run\n";
+    std::cout << "  --watch=NAME|ADDR[:LEN][,...]    report every store to these variables or address ranges (stderr)\n";
+    std::cout << "  --stats=FILE                     write a JSON report of the run (phase times, MIPS, opcode mix, memory)\n";
+    std::cout << "  --incremental                    keep the menu open after a run; later runs of an edited program\n";
+    std::cout << "                                   resume from the last run's checkpoints\n";
+    std::cout << "  --trace                          print every executed instruction and the registers (stderr)\n";
+    std::cout << "  --fast                           unchecked engine without models or tracing\n";
+    std::cout << "  --batch=FILE                     run the jobs listed in FILE concurrently (PROGRAM DATA OUTPUT [PRIORITY [BUDGET]])\n";
+    std::cout << "  --workers=N                      worker threads for --batch (default: hardware threads)\n";
+    std::cout << "  --quantum=N                      instructions per time slice for --batch (default 10000)\n";
+    std::cout << "  --batch-timeout=SECONDS          cancel the --batch jobs still running after SECONDS\n";
+    std::cout << "  --elf=FILE                       run a static RV32I ELF executable instead of the menu\n";
+}
+
+int main(int argc, char* argv[]) {
     // Initialize CPU and memory with default files
     // You can change these filenames as needed
     std::string codeFile = "default.txt";   
     std::string dataFile = "default_data.txt";
     std::string outputFile = "output.txt";
+    std::ofstream consoleFile; // declared before the CPU so it outlives the console
     // CPU cpu(codeFile, dataFile);
     // Alternatively, you can use the default constructor for non-interactive mode
     CPU cpu;
 
+    // Cache model is only built (and only costs anything) when --l1 is given
+    std::string l1Spec, l2Spec, value;
+    ReplacementPolicy replacement = ReplacementPolicy::LRU;
+    WritePolicy writePolicy = WritePolicy::WRITE_BACK;
+    uint32_t memoryLatency = 100;
+    bool timingEnabled = false;
+    PipelineConfig pipelineConfig;
+    std::string predictorNames;
+    uint32_t predictorBits = 10, historyBits = 8;
+    std::string elfFile;
+    uint64_t instructionBudget = 0;
+    std::string resultCacheDir;
+    uint64_t resultCacheSize = 64ull << 20;
+    std::string countersFile;
+    std::string dataImage;
+    uint64_t dataImageSize = 0;
+    Engine engine = Engine::CHECKED;
+    std::string batchFile;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t quantum = 10000;
+    double batchTimeout = 0;
+    std::string watchSpec;
+    std::string statsFile;
+    bool incremental = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        try {
+            if (parseOption(arg, "l1", value)) l1Spec = value;
+            else if (parseOption(arg, "l2", value)) l2Spec = value;
+            else if (parseOption(arg, "cache-replacement", value)) {
+                if (value == "lru") replacement = ReplacementPolicy::LRU;
+                else if (value == "random") replacement = ReplacementPolicy::RANDOM;
+                else { showUsage(); return 1; }
+            }
+            else if (parseOption(arg, "cache-write", value)) {
+                if (value == "back") writePolicy = WritePolicy::WRITE_BACK;
+                else if (value == "through") writePolicy = WritePolicy::WRITE_THROUGH;
+                else { showUsage(); return 1; }
+            }
+            else if (parseOption(arg, "mem-latency", value)) memoryLatency = parseNumber(value, 0, UINT32_MAX);
+            else if (arg == "--timing") timingEnabled = true;
+            else if (parseOption(arg, "branch-penalty", value)) pipelineConfig.branchPenalty = parseNumber(value, 0, UINT32_MAX);
+            else if (parseOption(arg, "mul-latency", value)) pipelineConfig.mulLatency = parseNumber(value, 0, UINT32_MAX);
+            else if (parseOption(arg, "bp", value)) predictorNames = value;
+            else if (parseOption(arg, "bp-bits", value)) predictorBits = parseNumber(value, 1, 24);
+            else if (parseOption(arg, "bp-history", value)) historyBits = parseNumber(value, 0, 32);
+            else if (parseOption(arg, "elf", value)) elfFile = value;
+            else if (parseOption(arg, "max-instructions", value)) instructionBudget = parseNumber(value, 0, UINT64_MAX);
+            else if (parseOption(arg, "result-cache", value)) resultCacheDir = value;
+            else if (parseOption(arg, "result-cache-size", value)) resultCacheSize = parseByteSize(value);
+            else if (parseOption(arg, "counters", value)) countersFile = value;
+            else if (parseOption(arg, "batch", value)) batchFile = value;
+            else if (parseOption(arg, "workers", value)) workers = parseNumber(value, 1, 4096);
+            else if (parseOption(arg, "quantum", value)) quantum = parseNumber(value, 1, UINT32_MAX);
+            else if (parseOption(arg, "batch-timeout", value)) batchTimeout = parseSeconds(value);
+            else if (parseOption(arg, "watch", value)) watchSpec = value;
+            else if (parseOption(arg, "stats", value)) statsFile = value;
+            else if (arg == "--incremental") incremental = true;
+            else if (arg == "--trace") engine = Engine::TRACE;
+            else if (arg == "--fast") engine = Engine::FAST;
+            else if (parseOption(arg, "data-image", value)) dataImage = value;
+            else if (parseOption(arg, "data-image-size", value)) dataImageSize = parseByteSize(value);
+            else if (parseOption(arg, "console", value)) {
+                consoleFile.open(value, std::ios::binary);
+                if (!consoleFile) { std::cerr << "Cannot open " << value << "\n"; return 1; }
+                cpu.getConsole().setOutput(consoleFile);
+            }
+            else { showUsage(); return 1; }
+        } catch (const std::exception& e) { // malformed number or size
+            std::cerr << "Invalid value in " << arg << ": " << e.what() << "\n";
+            return 1;
+        }
+    }
+    // The fast engine has the models, watchpoints and statistics hooks compiled out
+    if (engine == Engine::FAST && (!l1Spec.empty() || timingEnabled || !predictorNames.empty() || !watchSpec.empty()
+                                   || !statsFile.empty())) {
+        std::cerr << "--fast cannot be combined with --l1, --timing, --bp, --watch or --stats\n";
+        return 1;
+    }
+    // A resumed run only executes the tail, which is all the observers would see
+    if (incremental && (engine == Engine::FAST || !l1Spec.empty() || timingEnabled || !predictorNames.empty()
+                        || !watchSpec.empty() || !statsFile.empty() || !elfFile.empty() || !dataImage.empty()
+                        || !batchFile.empty())) {
+        std::cerr << "--incremental cannot be combined with --fast, --l1, --timing, --bp, --watch, --stats, --elf, --data-image or --batch\n";
+        return 1;
+    }
+    // Batch jobs run on CPUs of their own, which the models are not attached to
+    if (!batchFile.empty() && (!l1Spec.empty() || timingEnabled || !predictorNames.empty() || !watchSpec.empty()
+                               || !statsFile.empty())) {
+        std::cerr << "--batch cannot be combined with --l1, --timing, --bp, --watch or --stats\n";
+        return 1;
+    }
+    cpu.setEngine(engine);
+    if (!batchFile.empty()) return runBatch(batchFile, workers, quantum, engine, instructionBudget, batchTimeout);
+    std::unique_ptr<CacheHierarchy> cache;
+    if (!l1Spec.empty()) {
+        cache = std::make_unique<CacheHierarchy>(parseCacheConfig(l1Spec, 1), replacement, writePolicy, memoryLatency);
+        if (!l2Spec.empty()) cache->addL2(parseCacheConfig(l2Spec, 10));
+        cpu.attachCache(cache.get());
+    }
+    std::unique_ptr<PipelineModel> timing;
+    if (timingEnabled) {
+        timing = std::make_unique<PipelineModel>(pipelineConfig);
+        cpu.attachTiming(timing.get());
+    }
+    std::unique_ptr<BranchPredictorSet> predictors;
+    if (!predictorNames.empty()) {
+        predictors = std::make_unique<BranchPredictorSet>();
+        std::stringstream names(predictorNames);
+        std::string name;
+        while (std::getline(names, name, ','))
+            predictors->add(makeBranchPredictor(name, predictorBits, historyBits));
+        cpu.attachBranchPredictors(predictors.get());
+    }
+    // Variable names resolve against the data loaded from the menu, so the spec is added at run time
+    std::unique_ptr<WatchpointSet> watches;
+    if (!watchSpec.empty()) {
+        watches = std::make_unique<WatchpointSet>([](const WatchHit& hit) { WatchpointSet::printHit(std::cerr, hit); });
+        cpu.attachWatchpoints(watches.get());
+    }
+    std::unique_ptr<RunStats> stats;
+    if (!statsFile.empty()) {
+        stats = std::make_unique<RunStats>();
+        cpu.attachStats(stats.get());
+    }
+    auto writeStats = [&]() {
+        std::ofstream out(statsFile);
+        if (!out) throw std::runtime_error("Failed to open stats file.");
+        stats->writeJson(out, cpu, elfFile.empty() ? codeFile : elfFile, elfFile.empty() ? dataFile : "");
+    };
+    cpu.setInstructionBudget(instructionBudget);
+    if (!dataImage.empty()) cpu.getMemory()->mapDataImage(dataImage, 0, dataImageSize);
+    // A cached result is only the memory dump, so runs that produce reports still execute
+    std::unique_ptr<ResultCache> resultCache;
+    if (!resultCacheDir.empty() && !cache && !timing && !predictors && !watches && !stats && !incremental && countersFile.empty() && dataImage.empty())
+        resultCache = std::make_unique<ResultCache>(resultCacheDir, resultCacheSize);
+
+    // An ELF program replaces the menu: run it and exit with its exit code
+    if (!elfFile.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        cpu.loadElf(elfFile);
+        if (stats) stats->addPhase("parse", secondsSince(start));
+        if (watches) watches->addFromSpec(watchSpec, *cpu.getMemory());
+        start = std::chrono::steady_clock::now();
+        cpu.run();
+        if (stats) stats->addPhase("execute", secondsSince(start));
+        std::cout.flush();
+        if (!countersFile.empty()) cpu.saveCountersToFile(countersFile);
+        if (cache) cache->report(std::cout);
+        if (predictors) predictors->report(std::cout, *cpu.getMemory());
+        if (timing) timing->report(std::cout, *cpu.getMemory());
+        if (watches) watches->report(std::cout);
+        if (stats) writeStats();
+        return cpu.getExitCode();
+    }
+
+    std::unique_ptr<IncrementalSession> session;
+    if (incremental) {
+        std::ostream& consoleOut = consoleFile.is_open() ? static_cast<std::ostream&>(consoleFile) : std::cout;
+        session = std::make_unique<IncrementalSession>(cpu, consoleOut);
+    }
+
     uint32_t nextVarAddress = 0;
     bool running = true;
     while (running) {
         // showMenu();
         int choice = -1;
-        std::cin >> choice;
+        if (!(std::cin >> choice)) break; // end of input
+        auto start = std::chrono::steady_clock::now();
         switch (choice) {
             case 1:
                 InstructionEntryOptions(cpu.getMemory(), codeFile);
+                if (stats) stats->addPhase("parse", secondsSince(start));
                 break;
             case 2:
                 dataEntryOptions(cpu.getMemory(), nextVarAddress, dataFile);
+                if (session) session->dataChanged();
+                if (stats) stats->addPhase("data_load", secondsSince(start));
                 break;
             case 3: {
                 // std::cout << "Running assembly simulator...\n";
-                cpu.run();
+                std::string key, result;
+                if (resultCache) {
+                    key = ResultCache::makeKey(*cpu.getMemory(), instructionBudget);
+                    if (resultCache->lookup(key, result)) {
+                        std::ofstream(outputFile) << result;
+                        running = false;
+                        break;
+                    }
+                }
+                if (watches) watches->addFromSpec(watchSpec, *cpu.getMemory());
+                start = std::chrono::steady_clock::now();
+                if (session) {
+                    uint64_t skipped;
+                    try {
+                        skipped = session->run(instructionBudget);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error: " << e.what() << "\n"; // fix the program and run again
+                        break;
+                    }
+                    if (skipped) std::cerr << "Resumed after " << skipped << " of " << cpu.getInstret() << " instructions.\n";
+                } else {
+                    cpu.run();
+                }
+                if (stats) stats->addPhase("execute", secondsSince(start));
+                if (cpu.budgetExhausted())
+                    std::cerr << "Stopped after " << instructionBudget << " instructions.\n";
+                if (!countersFile.empty()) cpu.saveCountersToFile(countersFile);
                 // Save data on exit (optional)
                 // can save data in input_data file itself
                 // saved in output.txt for running testcases.
-                cpu.getMemory()->saveDataToFile(outputFile);
-                running = false;
+                start = std::chrono::steady_clock::now();
+                if (resultCache) {
+                    std::ostringstream dump;
+                    cpu.getMemory()->saveData(dump);
+                    result = dump.str();
+                    // Only the memory dump is cached, so runs that print must execute again
+                    if (cpu.getConsole().bytesWritten() == 0) resultCache->store(key, result);
+                    std::ofstream(outputFile) << result;
+                } else {
+                    cpu.getMemory()->saveDataToFile(outputFile);
+                }
+                // The data image itself is the result; output.txt only lists its named variables
+                if (cpu.getMemory()->hasDataImage()) cpu.getMemory()->syncDataImage();
+                if (stats) stats->addPhase("save", secondsSince(start));
+                if (cache) cache->report(std::cout);
+                if (predictors) predictors->report(std::cout, *cpu.getMemory());
+                if (timing) timing->report(std::cout, *cpu.getMemory());
+                if (watches) watches->report(std::cout);
+                if (stats) writeStats();
+                running = incremental; // an incremental session goes back to the menu for the next edit
                 break;
             }
             case 0: